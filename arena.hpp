@@ -0,0 +1,109 @@
+#ifndef arena_hpp
+#define arena_hpp
+#include <new>
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <type_traits>
+#include <typeindex>
+#include <unordered_map>
+
+struct AllocationCount
+{
+    size_t count = 0;
+    size_t bytes = 0;
+};
+typedef std::unordered_map<std::type_index, AllocationCount> AllocationCounts;
+
+struct Arena
+{
+    static constexpr size_t FIRST_BLOCK_SIZE = 1024;
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+    std::vector<char*> blocks;
+    std::vector<std::pair<void*, void (*)(void*)>> finalizers;
+    char* cursor = nullptr;
+    char* limit = nullptr;
+    size_t bytes = 0;
+    size_t reserved = 0;
+    size_t nodes = 0;
+    AllocationCounts* counts = nullptr;
+    Arena() = default;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    Arena(Arena&& other) noexcept:
+    blocks(std::move(other.blocks)), finalizers(std::move(other.finalizers)),
+    cursor(other.cursor), limit(other.limit),
+    bytes(other.bytes), reserved(other.reserved), nodes(other.nodes), counts(other.counts)
+    {
+        other.blocks.clear();
+        other.finalizers.clear();
+        other.cursor = other.limit = nullptr;
+        other.bytes = other.reserved = other.nodes = 0;
+    }
+    ~Arena()
+    {
+        for(size_t i = finalizers.size(); i > 0; i--)
+        finalizers[i - 1].second(finalizers[i - 1].first);
+        for(char* block : blocks)
+        ::operator delete(block);
+    }
+    void* allocate(size_t size, size_t align)
+    {
+        uintptr_t aligned = (reinterpret_cast<uintptr_t>(cursor) + align - 1) & ~(uintptr_t)(align - 1);
+        if(cursor == nullptr || aligned + size > reinterpret_cast<uintptr_t>(limit))
+        {
+            size_t blockSize = blocks.empty() ? FIRST_BLOCK_SIZE : std::min(reserved, BLOCK_SIZE);
+            if(size + align > blockSize)
+            blockSize = size + align;
+            char* block = static_cast<char*>(::operator new(blockSize));
+            blocks.push_back(block);
+            reserved += blockSize;
+            cursor = block;
+            limit = block + blockSize;
+            aligned = (reinterpret_cast<uintptr_t>(cursor) + align - 1) & ~(uintptr_t)(align - 1);
+        }
+        cursor = reinterpret_cast<char*>(aligned + size);
+        bytes += size;
+        return reinterpret_cast<void*>(aligned);
+    }
+    void count(const std::type_info& type, size_t size)
+    {
+        AllocationCount& entry = (*counts)[type];
+        entry.count++;
+        entry.bytes += size;
+    }
+    template<typename T, typename... Args>
+    T* create(Args&&... args)
+    {
+        if(counts != nullptr)
+        count(typeid(T), sizeof(T));
+        T* object = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        if constexpr(!std::is_trivially_destructible<T>::value)
+        finalizers.emplace_back(object, [](void* object){ static_cast<T*>(object)->~T(); });
+        return object;
+    }
+    template<typename T>
+    T* copy(const T& value)
+    {
+        return create<T>(value);
+    }
+    template<typename T>
+    T* array(const std::vector<T>& items)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "arena arrays hold plain values");
+        if(counts != nullptr)
+        count(typeid(T[]), sizeof(T) * items.size());
+        T* copy = static_cast<T*>(allocate(sizeof(T) * items.size(), alignof(T)));
+        std::copy(items.begin(), items.end(), copy);
+        return copy;
+    }
+    template<typename T, typename... Args>
+    T* make(Args&&... args)
+    {
+        nodes++;
+        return create<T>(std::forward<Args>(args)...);
+    }
+};
+#endif
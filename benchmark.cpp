@@ -0,0 +1,791 @@
+#include <new>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <functional>
+#include <fcntl.h>
+#include "metal.hpp"
+#include "script_cache.hpp"
+
+static std::atomic<size_t> allocations{0};
+
+static void* allocate(size_t size, size_t alignment = 0)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    size = size == 0 ? 1 : size;
+    void* memory = alignment == 0 ? std::malloc(size) : std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+    if(memory == nullptr)
+    throw std::bad_alloc();
+    return memory;
+}
+void* operator new(size_t size)
+{
+    return allocate(size);
+}
+void* operator new[](size_t size)
+{
+    return allocate(size);
+}
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    return allocate(size, static_cast<size_t>(alignment));
+}
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+    return allocate(size, static_cast<size_t>(alignment));
+}
+void operator delete(void* memory) noexcept
+{
+    std::free(memory);
+}
+void operator delete[](void* memory) noexcept
+{
+    std::free(memory);
+}
+void operator delete(void* memory, size_t) noexcept
+{
+    std::free(memory);
+}
+void operator delete[](void* memory, size_t) noexcept
+{
+    std::free(memory);
+}
+void operator delete(void* memory, std::align_val_t) noexcept
+{
+    std::free(memory);
+}
+void operator delete[](void* memory, std::align_val_t) noexcept
+{
+    std::free(memory);
+}
+void operator delete(void* memory, size_t, std::align_val_t) noexcept
+{
+    std::free(memory);
+}
+void operator delete[](void* memory, size_t, std::align_val_t) noexcept
+{
+    std::free(memory);
+}
+
+struct generator
+{
+    uint32_t state = 12345;
+    std::string text;
+    uint32_t next(uint32_t range)
+    {
+        state = state * 1103515245 + 12345;
+        return (state >> 8) % range;
+    }
+    void number()
+    {
+        text += std::to_string(next(1000));
+        if(next(2) == 0)
+        {
+            text += ".";
+            text += std::to_string(next(100));
+        }
+    }
+    std::vector<size_t> defined;
+    std::string pick(const char* prefix)
+    {
+        return prefix + std::to_string(defined[next(defined.size())]);
+    }
+    void arithmetic(size_t statements)
+    {
+        defined.assign(1, 0);
+        text += "var a0 = 1;\n";
+        for(size_t i = 1; i < statements; i++)
+        {
+            if(i % 4 == 0)
+            {
+                text += "print " + pick("a") + " * 2 - " + pick("a") + ";\n";
+                continue;
+            }
+            text += "var a" + std::to_string(i) + " = (" + pick("a") + " + ";
+            number();
+            text += ") * ";
+            number();
+            text += " / (1 + ";
+            number();
+            text += ") - " + pick("a") + ";\n";
+            defined.push_back(i);
+        }
+    }
+    void strings(size_t statements)
+    {
+        defined.assign(1, 0);
+        text += "var s0 = \"report\";\n";
+        for(size_t i = 1; i < statements; i++)
+        {
+            std::string name = "var s" + std::to_string(i) + " = ";
+            switch(i % 4)
+            {
+                case 0:
+                text += "print " + pick("s") + " == \"report\";\n";
+                continue;
+                case 1:
+                text += name + pick("s") + " + \" line " + std::to_string(i) + "\";\n";
+                break;
+                case 2:
+                text += name + "\"column\" + \" \" + \"value\";\n";
+                break;
+                default:
+                text += name + pick("s") + ";\n";
+                break;
+            }
+            defined.push_back(i);
+        }
+    }
+    void variables(size_t statements)
+    {
+        size_t names = statements / 2;
+        for(size_t i = 0; i < names; i++)
+        text += "var variable_with_a_longer_name_" + std::to_string(i) + " = " + std::to_string(i) + ";\n";
+        for(size_t i = names; i < statements; i++)
+        {
+            std::string target = "variable_with_a_longer_name_" + std::to_string(next(names));
+            text += target + " = " + target + " + variable_with_a_longer_name_" + std::to_string(next(names)) + ";\n";
+        }
+    }
+    void nesting(size_t statements, int depth)
+    {
+        text += "var n = 0;\n";
+        size_t written = 1;
+        while(written < statements)
+        {
+            for(int level = 0; level < depth; level++)
+            text += "if(n >= 0) {\n";
+            text += "n = ";
+            for(int level = 0; level < depth; level++)
+            text += "(";
+            text += "n";
+            for(int level = 0; level < depth; level++)
+            text += " + 1)";
+            text += ";\n";
+            for(int level = 0; level < depth; level++)
+            text += "}\n";
+            written += depth + 1;
+        }
+        text += "print n;\n";
+    }
+    void prose(size_t statements)
+    {
+        text += "var banner_message_for_the_report = \"report\";\n";
+        for(size_t i = 1; i < statements; i += 2)
+        {
+            text += "if (banner_message_for_the_report == \"report\") {\n";
+            text += "        print \"a longer line of report text that runs on for a while, entry " + std::to_string(i) + "\";\n";
+            text += "}\n";
+        }
+    }
+    void loops(size_t statements)
+    {
+        text += "fun step(x) { return x + 1; }\n";
+        text += "var total = 0;\n";
+        text += "var i = 0;\n";
+        text += "while (i < " + std::to_string(statements / 10) + ")\n{\n";
+        text += "    var j = 0;\n";
+        text += "    while (j < 10)\n    {\n        total = step(total);\n        j = j + 1;\n    }\n";
+        text += "    i = i + 1;\n}\n";
+        text += "print total;\n";
+    }
+    void binary(size_t statements)
+    {
+        text += "var a = 1.5;\nvar b = 2.25;\nvar c = 3;\nvar d = 4.5;\nvar r = 0;\n";
+        for(size_t i = 0; i < statements; i++)
+        text += "r = a + b * c - d / a + b * c - d < a;\n";
+    }
+    void concatenation(size_t pieces)
+    {
+        text += "var s = \"\";\nvar i = 0;\n";
+        text += "while (i < " + std::to_string(pieces) + ")\n{\n    s = s + \"piece\";\n    i = i + 1;\n}\n";
+        text += "print s;\n";
+    }
+    void lines(size_t count)
+    {
+        text += "var i = 0;\n";
+        text += "while (i < " + std::to_string(count) + ")\n{\n    print \"one line of report output\";\n    i = i + 1;\n}\n";
+    }
+    void formatting(size_t count)
+    {
+        text += "var x = 0.125;\nvar i = 0;\n";
+        text += "while (i < " + std::to_string(count / 4) + ")\n{\n    print x;\n    print x * 3;\n    print -x;\n    print i;\n";
+        text += "    x = x * 1.0001 + 0.37;\n    i = i + 1;\n}\n";
+    }
+    void literals(size_t count)
+    {
+        for(size_t i = 0; i < count; i++)
+        {
+            text += "print ";
+            number();
+            text += ";\n";
+        }
+    }
+    void fib(int n)
+    {
+        text += "fun fib(n) {\n    if (n < 2) return n;\n    return fib(n - 1) + fib(n - 2);\n}\n";
+        text += "print fib(" + std::to_string(n) + ");\n";
+    }
+    static size_t fibCalls(int n)
+    {
+        size_t previous = 1;
+        size_t current = 1;
+        for(int i = 1; i < n; i++)
+        {
+            size_t next = previous + current + 1;
+            previous = current;
+            current = next;
+        }
+        return current;
+    }
+    void errors(size_t statements)
+    {
+        for(size_t i = 0; i < statements; i++)
+        {
+            switch(next(8))
+            {
+                case 0:
+                text += "var e" + std::to_string(i) + " = (";
+                number();
+                text += " + 2;\n";
+                break;
+                case 1:
+                text += "print ";
+                number();
+                text += " @ 2;\n";
+                break;
+                case 2:
+                text += "var = ";
+                number();
+                text += ";\n";
+                break;
+                case 3:
+                text += "if (";
+                number();
+                text += " > ) print 1;\n";
+                break;
+                case 4:
+                text += "{ print ";
+                number();
+                text += " }\n";
+                break;
+                default:
+                text += "var v" + std::to_string(i) + " = ";
+                number();
+                text += " * 2;\n";
+                break;
+            }
+        }
+    }
+};
+
+size_t count_statements(const Stmt* statement)
+{
+    size_t count = 1;
+    if(const Block* block = dynamic_cast<const Block*>(statement))
+    {
+        for(uint32_t i = 0; i < block->count; i++)
+        count += count_statements(block->statements[i]);
+    }
+    else if(const If* branch = dynamic_cast<const If*>(statement))
+    {
+        count += count_statements(branch->thenBranch);
+        if(branch->elseBranch != nullptr)
+        count += count_statements(branch->elseBranch);
+    }
+    else if(const While* loop = dynamic_cast<const While*>(statement))
+    count += count_statements(loop->body);
+    return count;
+}
+
+struct Phase
+{
+    double seconds = 0;
+    size_t allocations = 0;
+};
+
+Phase measure(int repeat, const std::function<void()>& setup, const std::function<void()>& body)
+{
+    Phase best;
+    best.seconds = 1e300;
+    for(int i = 0; i < repeat; i++)
+    {
+        setup();
+        size_t before = allocations;
+        auto start = std::chrono::steady_clock::now();
+        body();
+        auto end = std::chrono::steady_clock::now();
+        size_t count = allocations - before;
+        double seconds = std::chrono::duration<double>(end - start).count();
+        if(seconds < best.seconds)
+        {
+            best.seconds = seconds;
+            best.allocations = count;
+        }
+    }
+    return best;
+}
+
+struct Result
+{
+    std::string corpus;
+    size_t bytes = 0;
+    size_t tokens = 0;
+    size_t nodes = 0;
+    size_t statements = 0;
+    Phase scan;
+    Phase parse;
+    Phase resolve;
+    Phase interpret;
+    Phase interpretLimited;
+    size_t fused = 0;
+    Phase interpretFused;
+    Phase compile;
+    Phase run;
+    Phase runLimited;
+    int parsers = 1;
+    Phase frontEnd;
+    Phase frontEndParallel;
+};
+
+Result run_corpus(const std::string& name, const std::string& source, int repeat)
+{
+    Result result;
+    result.corpus = name;
+    result.bytes = source.size();
+    SymbolTable symbols;
+    std::vector<Token> tokens;
+    result.scan = measure(repeat, [&](){ tokens = std::vector<Token>(); }, [&]()
+    {
+        scanner scanner1(source, symbols);
+        tokens = scanner1.scan_tokens();
+    });
+    result.tokens = tokens.size();
+    std::unique_ptr<Arena> arena;
+    std::vector<Stmt*> statements;
+    Diagnostics diagnostics;
+    result.parse = measure(repeat, [&](){ statements.clear(); arena.reset(); diagnostics.clear(); }, [&]()
+    {
+        arena = std::make_unique<Arena>();
+        scanner scanner1(source, symbols);
+        parser parser1(scanner1, *arena, diagnostics);
+        statements = parser1.parse();
+    });
+    result.nodes = arena->nodes;
+    for(const Stmt* statement : statements)
+    result.statements += count_statements(statement);
+    std::unique_ptr<resolver> resolver1;
+    result.resolve = measure(repeat, [&](){ resolver1 = std::make_unique<resolver>(); diagnostics.clear(); }, [&]()
+    {
+        for(Stmt* statement : statements)
+        resolver1->resolve(statement, diagnostics);
+        resolver1->finish(diagnostics);
+    });
+    if(!diagnostics.empty())
+    {
+        std::cerr << name << " : " << diagnostics.front().message << " at line " << diagnostics.front().line << std::endl;
+        std::exit(1);
+    }
+    std::string output;
+    Environment globals;
+    OutputSink sink;
+    sink.redirect(output);
+    interpreter interpreter1(globals, sink);
+    interpreter1.scriptSlots = resolver1->scriptSlots;
+    auto reset = [&]()
+    {
+        output.clear();
+        globals.slots.assign(resolver1->globalCount, Value());
+    };
+    result.interpret = measure(repeat, reset, [&]()
+    {
+        interpreter1.interpret(statements, diagnostics);
+    });
+    Limits limits;
+    limits.steps = 1ull << 50;
+    limits.milliseconds = 3600 * 1000;
+    limits.memory = 1ull << 40;
+    limits.output = 1ull << 40;
+    result.interpretLimited = measure(repeat, [&](){ reset(); interpreter1.meter.start(limits, sink); }, [&]()
+    {
+        interpreter1.interpret(statements, diagnostics);
+    });
+    interpreter1.meter.stop();
+    interpreter1.meter = budget();
+    fuser fuser1(*arena, result.fused);
+    for(Stmt*& statement : statements)
+    statement = fuser1.fuse(statement);
+    result.interpretFused = measure(repeat, reset, [&]()
+    {
+        interpreter1.interpret(statements, diagnostics);
+    });
+    std::unique_ptr<Chunk> chunk;
+    result.compile = measure(repeat, [&](){ chunk = std::make_unique<Chunk>(); }, [&]()
+    {
+        compiler compiler1(*chunk);
+        compiler1.compile(statements);
+    });
+    vm vm1(globals, sink);
+    result.run = measure(repeat, reset, [&]()
+    {
+        vm1.interpret(*chunk, diagnostics);
+    });
+    result.runLimited = measure(repeat, [&](){ reset(); vm1.meter.start(limits, sink); }, [&]()
+    {
+        vm1.interpret(*chunk, diagnostics);
+    });
+    vm1.meter.stop();
+    if(!diagnostics.empty())
+    {
+        std::cerr << name << " : " << diagnostics.front().message << " at line " << diagnostics.front().line << std::endl;
+        std::exit(1);
+    }
+    result.parsers = std::max(2u, std::thread::hardware_concurrency());
+    std::unique_ptr<Engine> engine;
+    std::unique_ptr<Script> script;
+    auto fresh = [&](){ script.reset(); engine = std::make_unique<Engine>(); };
+    result.frontEnd = measure(repeat, fresh, [&](){ script = engine->compile_view(source); });
+    result.frontEndParallel = measure(repeat, fresh, [&](){ script = engine->compile_view(source, result.parsers); });
+    return result;
+}
+
+struct Validation
+{
+    std::string corpus;
+    size_t bytes = 0;
+    size_t diagnostics = 0;
+    Phase validate;
+};
+
+Validation run_validation(const std::string& name, const std::string& source, int repeat)
+{
+    Validation result;
+    result.corpus = name;
+    result.bytes = source.size();
+    std::unique_ptr<Engine> engine;
+    std::unique_ptr<Script> script;
+    result.validate = measure(repeat, [&](){ script.reset(); engine = std::make_unique<Engine>(); }, [&]()
+    {
+        script = engine->compile(source);
+    });
+    result.diagnostics = script->diagnostics.size();
+    return result;
+}
+
+struct Case
+{
+    std::string name;
+    const char* unit = "";
+    size_t units = 0;
+    Phase phase;
+};
+
+Case run_case(const std::string& name, const char* unit, size_t units, const std::string& source, bool useVM, int repeat, int runs, const std::function<void(Context&)>& configure = nullptr)
+{
+    Case result;
+    result.name = name;
+    result.unit = unit;
+    result.units = units * runs;
+    Engine engine;
+    engine.useVM = useVM;
+    std::unique_ptr<Script> script = engine.compile(source);
+    if(!script->ok())
+    {
+        std::cerr << name << " : " << script->diagnostics.front().message << std::endl;
+        std::exit(1);
+    }
+    std::string output;
+    Context context(engine);
+    context.output(output);
+    if(configure)
+    configure(context);
+    result.phase = measure(repeat, [&](){ output.clear(); }, [&]()
+    {
+        for(int i = 0; i < runs; i++)
+        context.execute(*script);
+    });
+    return result;
+}
+
+Case run_scan_case(const std::string& name, const std::string& source, int repeat)
+{
+    Case result;
+    result.name = name;
+    result.unit = "number";
+    SymbolTable symbols;
+    size_t numbers = 0;
+    result.phase = measure(repeat, [&](){ numbers = 0; }, [&]()
+    {
+        scanner scanner1(source, symbols);
+        for(Token token = scanner1.next(); token.type != TokenType::EOF_TOKEN; token = scanner1.next())
+        {
+            if(token.type == TokenType::NUMBER)
+            numbers++;
+        }
+    });
+    result.units = numbers;
+    return result;
+}
+
+std::vector<Case> run_cache_cases(const std::string& source, int repeat)
+{
+    std::string directory = (std::filesystem::temp_directory_path() / ("metal-benchmark-" + std::to_string(getpid()))).string();
+    ScriptCache cache(directory);
+    std::unique_ptr<Engine> engine;
+    std::unique_ptr<Script> script;
+    auto fresh = [&](){ script.reset(); engine = std::make_unique<Engine>(); engine->useVM = true; };
+    std::vector<Case> cases(2);
+    cases[0].name = "cache_cold";
+    cases[0].phase = measure(repeat, [&](){ fresh(); std::filesystem::remove_all(directory); }, [&]()
+    {
+        script = cache.load(*engine, source);
+        if(script == nullptr)
+        {
+            script = engine->compile(source);
+            cache.store(*engine, *script, source);
+        }
+    });
+    cases[1].name = "cache_warm";
+    cases[1].phase = measure(repeat, fresh, [&]()
+    {
+        script = cache.load(*engine, source);
+    });
+    if(script == nullptr)
+    {
+        std::cerr << "cache_warm : cached script did not load" << std::endl;
+        std::exit(1);
+    }
+    std::filesystem::remove_all(directory);
+    for(Case& item : cases)
+    {
+        item.unit = "startup";
+        item.units = 1;
+    }
+    return cases;
+}
+
+std::vector<Case> run_global_cases(size_t lookups, int repeat)
+{
+    Engine engine;
+    std::vector<std::string> names;
+    std::vector<int32_t> slots;
+    for(int i = 0; i < 1024; i++)
+    {
+        names.push_back("global_with_a_longer_name_" + std::to_string(i));
+        slots.push_back(engine.declare(names.back()));
+    }
+    Context context(engine);
+    double sum = 0;
+    std::vector<Case> cases(2);
+    cases[0].name = "global_by_name";
+    cases[0].phase = measure(repeat, [](){}, [&]()
+    {
+        for(size_t i = 0; i < lookups / 2; i++)
+        {
+            const std::string& name = names[i % names.size()];
+            context.set(name, (double)i);
+            sum += context.get(name).asNumber();
+        }
+    });
+    cases[1].name = "global_by_slot";
+    cases[1].phase = measure(repeat, [](){}, [&]()
+    {
+        for(size_t i = 0; i < lookups / 2; i++)
+        {
+            int32_t slot = slots[i % slots.size()];
+            context.set(slot, (double)i);
+            sum += context.get(slot).asNumber();
+        }
+    });
+    if(sum < 0)
+    std::exit(1);
+    for(Case& item : cases)
+    {
+        item.unit = "lookup";
+        item.units = lookups / 2 * 2;
+    }
+    return cases;
+}
+
+Case run_concurrent(const std::string& name, const std::string& source, int threads, int repeat, int runs)
+{
+    Case result;
+    result.name = name;
+    result.unit = "run";
+    result.units = (size_t)threads * runs;
+    Engine engine;
+    std::unique_ptr<Script> script = engine.compile(source);
+    result.phase = measure(repeat, [](){}, [&]()
+    {
+        for(int i = 0; i < runs; i++)
+        execute_concurrently(engine, *script, threads);
+    });
+    return result;
+}
+
+void write_phase(std::ostream& out, const char* name, const Phase& phase, const char* rateName, size_t units, size_t statements)
+{
+    out << "      \"" << name << "\": {\"seconds\": " << phase.seconds;
+    out << ", \"" << rateName << "\": " << units / phase.seconds;
+    out << ", \"allocations\": " << phase.allocations;
+    out << ", \"allocations_per_statement\": " << (double)phase.allocations / statements << "}";
+}
+
+void write_json(std::ostream& out, const std::vector<Result>& results, const std::vector<Validation>& validations, const std::vector<Case>& cases)
+{
+    out << std::setprecision(6);
+    out << "{\n  \"benchmarks\": [\n";
+    for(size_t i = 0; i < results.size(); i++)
+    {
+        const Result& result = results[i];
+        out << "    {\n";
+        out << "      \"corpus\": \"" << result.corpus << "\",\n";
+        out << "      \"bytes\": " << result.bytes << ", \"tokens\": " << result.tokens;
+        out << ", \"nodes\": " << result.nodes << ", \"statements\": " << result.statements << ",\n";
+        write_phase(out, "scan", result.scan, "tokens_per_sec", result.tokens, result.statements);
+        out << ",\n";
+        write_phase(out, "parse", result.parse, "nodes_per_sec", result.nodes, result.statements);
+        out << ",\n";
+        write_phase(out, "resolve", result.resolve, "statements_per_sec", result.statements, result.statements);
+        out << ",\n";
+        write_phase(out, "interpret", result.interpret, "statements_per_sec", result.statements, result.statements);
+        out << ",\n";
+        write_phase(out, "interpret_limited", result.interpretLimited, "statements_per_sec", result.statements, result.statements);
+        out << ",\n";
+        write_phase(out, "interpret_fused", result.interpretFused, "statements_per_sec", result.statements, result.statements);
+        out << ",\n";
+        write_phase(out, "compile", result.compile, "statements_per_sec", result.statements, result.statements);
+        out << ",\n";
+        write_phase(out, "vm", result.run, "statements_per_sec", result.statements, result.statements);
+        out << ",\n";
+        write_phase(out, "vm_limited", result.runLimited, "statements_per_sec", result.statements, result.statements);
+        out << ",\n";
+        write_phase(out, "front_end", result.frontEnd, "bytes_per_sec", result.bytes, result.statements);
+        out << ",\n";
+        write_phase(out, "front_end_parallel", result.frontEndParallel, "bytes_per_sec", result.bytes, result.statements);
+        out << ",\n      \"fused\": " << result.fused << ", \"parsers\": " << result.parsers;
+        out << "\n    }" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ],\n  \"validation\": [\n";
+    for(size_t i = 0; i < validations.size(); i++)
+    {
+        const Validation& validation = validations[i];
+        out << "    {\"corpus\": \"" << validation.corpus << "\", \"bytes\": " << validation.bytes;
+        out << ", \"diagnostics\": " << validation.diagnostics << ", \"seconds\": " << validation.validate.seconds;
+        out << ", \"bytes_per_sec\": " << validation.bytes / validation.validate.seconds;
+        out << ", \"allocations_per_diagnostic\": " << (double)validation.validate.allocations / std::max<size_t>(validation.diagnostics, 1) << "}";
+        out << (i + 1 < validations.size() ? "," : "") << "\n";
+    }
+    out << "  ],\n  \"cases\": [\n";
+    for(size_t i = 0; i < cases.size(); i++)
+    {
+        const Case& item = cases[i];
+        out << "    {\"case\": \"" << item.name << "\", \"" << item.unit << "s\": " << item.units;
+        out << ", \"seconds\": " << item.phase.seconds << ", \"" << item.unit << "s_per_sec\": " << item.units / item.phase.seconds;
+        out << ", \"ns_per_" << item.unit << "\": " << item.phase.seconds * 1e9 / item.units << "}";
+        out << (i + 1 < cases.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+int main(int argc, char* argv[])
+{
+    int repeat = 5;
+    double scale = 1;
+    for(int arg = 1; arg < argc; arg++)
+    {
+        std::string flag = argv[arg];
+        if(flag == "--repeat" && arg + 1 < argc)
+        repeat = std::max(1, std::atoi(argv[++arg]));
+        else if(flag == "--scale" && arg + 1 < argc)
+        scale = std::max(0.01, std::atof(argv[++arg]));
+        else
+        {
+            std::cerr << "usage : benchmark [--repeat N] [--scale S]" << std::endl;
+            return 64;
+        }
+    }
+    size_t statements = 50000 * scale;
+    std::vector<std::pair<std::string, std::string>> corpora;
+    generator arithmetic;
+    arithmetic.arithmetic(statements);
+    corpora.emplace_back("arithmetic", std::move(arithmetic.text));
+    generator strings;
+    strings.strings(statements);
+    corpora.emplace_back("strings", std::move(strings.text));
+    generator variables;
+    variables.variables(statements);
+    corpora.emplace_back("variables", std::move(variables.text));
+    generator nesting;
+    nesting.nesting(statements, 48);
+    corpora.emplace_back("nesting", std::move(nesting.text));
+    generator prose;
+    prose.prose(statements);
+    corpora.emplace_back("prose", std::move(prose.text));
+    generator loops;
+    loops.loops(statements);
+    corpora.emplace_back("loops", std::move(loops.text));
+    generator large;
+    large.arithmetic(statements * 10);
+    corpora.emplace_back("large", std::move(large.text));
+    std::vector<Result> results;
+    for(const auto& corpus : corpora)
+    results.push_back(run_corpus(corpus.first, corpus.second, repeat));
+    generator errors;
+    errors.errors(statements);
+    std::vector<Validation> validations;
+    validations.push_back(run_validation("errors", errors.text, repeat));
+    std::vector<Case> cases;
+    size_t binaryStatements = 20000 * scale;
+    generator binary;
+    binary.binary(binaryStatements);
+    cases.push_back(run_case("binary_ops_tree", "op", binaryStatements * 8, binary.text, false, repeat, 10));
+    cases.push_back(run_case("binary_ops_vm", "op", binaryStatements * 8, binary.text, true, repeat, 10));
+    int depth = std::max(10, 25 + (int)std::round(std::log2(scale) / std::log2(1.618)));
+    generator fib;
+    fib.fib(depth);
+    cases.push_back(run_case("fib_calls_tree", "call", generator::fibCalls(depth), fib.text, false, repeat, 1));
+    cases.push_back(run_case("fib_calls_vm", "call", generator::fibCalls(depth), fib.text, true, repeat, 1));
+    size_t pieces = 1000000 * scale;
+    generator concatenation;
+    concatenation.concatenation(pieces);
+    cases.push_back(run_case("concat_pieces_tree", "piece", pieces, concatenation.text, false, repeat, 1));
+    cases.push_back(run_case("concat_pieces_vm", "piece", pieces, concatenation.text, true, repeat, 1));
+    size_t printed = 200000 * scale;
+    generator lines;
+    lines.lines(printed);
+    int null = open("/dev/null", O_WRONLY);
+    auto discard = [null](bool flushed)
+    {
+        return [null, flushed](Context& context)
+        {
+            context.output(null);
+            context.sink.interactive = flushed;
+        };
+    };
+    cases.push_back(run_case("print_buffered", "line", printed, lines.text, true, repeat, 1, discard(false)));
+    cases.push_back(run_case("print_flushed", "line", printed, lines.text, true, repeat, 1, discard(true)));
+    close(null);
+    size_t numbers = 200000 * scale;
+    generator formatting;
+    formatting.formatting(numbers);
+    cases.push_back(run_case("format_numbers", "number", numbers / 4 * 4, formatting.text, true, repeat, 1));
+    generator literals;
+    literals.literals(numbers);
+    cases.push_back(run_scan_case("scan_numbers", literals.text, repeat));
+    for(Case& item : run_cache_cases(corpora.front().second, repeat))
+    cases.push_back(std::move(item));
+    for(Case& item : run_global_cases(2000000 * scale, repeat))
+    cases.push_back(std::move(item));
+    generator worker;
+    worker.loops(20000 * scale);
+    int cores = std::max(4u, std::thread::hardware_concurrency());
+    for(int threads = 1; threads <= cores; threads *= 2)
+    cases.push_back(run_concurrent("concurrent_" + std::to_string(threads) + "_threads", worker.text, threads, repeat, 4));
+    write_json(std::cout, results, validations, cases);
+}
@@ -0,0 +1,62 @@
+#ifndef budget_hpp
+#define budget_hpp
+#include <chrono>
+#include "output_sink.hpp"
+
+struct Limits
+{
+    uint64_t steps = 0;
+    uint64_t milliseconds = 0;
+    size_t memory = 0;
+    size_t output = 0;
+};
+
+struct budget
+{
+    static constexpr uint32_t INTERVAL = 1024;
+    Limits limits;
+    uint32_t countdown = INTERVAL;
+    uint32_t interval = INTERVAL;
+    uint64_t steps = 0;
+    std::chrono::steady_clock::time_point deadline;
+    OutputSink* sink = nullptr;
+    void start(const Limits& limits, OutputSink& sink)
+    {
+        this->limits = limits;
+        this->sink = &sink;
+        steps = 0;
+        deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(limits.milliseconds);
+        StringObject::Usage& usage = StringObject::usage();
+        usage.ceiling = limits.memory != 0 ? usage.bytes + limits.memory : 0;
+        sink.ceiling = limits.output != 0 ? sink.written + limits.output : 0;
+        refill();
+    }
+    void stop()
+    {
+        StringObject::usage().ceiling = 0;
+        if(sink != nullptr)
+        sink->ceiling = 0;
+    }
+    void refill()
+    {
+        interval = INTERVAL;
+        if(limits.steps != 0 && limits.steps - steps < INTERVAL)
+        interval = limits.steps - steps + 1;
+        countdown = interval;
+    }
+    bool tick()
+    {
+        return --countdown == 0;
+    }
+    const char* charge()
+    {
+        steps += interval;
+        if(limits.steps != 0 && steps > limits.steps)
+        return "Step limit exceeded.";
+        if(limits.milliseconds != 0 && std::chrono::steady_clock::now() >= deadline)
+        return "Time limit exceeded.";
+        refill();
+        return nullptr;
+    }
+};
+#endif
@@ -0,0 +1,17 @@
+#!/bin/sh
+metal=${1:-./metal}
+directory=$(dirname "$0")
+failed=0
+for script in "$directory"/*.mt
+do
+    expected="${script%.mt}.out"
+    for mode in "" "--vm" "-O" "-O --vm"
+    do
+        if ! "$metal" $mode "$script" 2>&1 | cmp -s - "$expected"
+        then
+            echo "FAIL ${mode:-tree} $script"
+            failed=1
+        fi
+    done
+done
+exit $failed
@@ -1,85 +1,308 @@
-#include <vector>
-#include <string>
-#include <memory>
-#include <cstdlib>
-#include <fstream>
-#include <sstream>
-#include <iostream>
-#include "scanner.hpp"
-#include "interpreter.hpp"
-
-bool hadError = false;
-void run(const std::string& source)
-{
-    scanner scanner1(source);
-    std::vector<std::shared_ptr<Token>> tokens = scanner1.scan_tokens();
-    parser parser1(tokens);
-    std::vector<std::shared_ptr<Stmt>> statements = parser1.parse();
-    if(hadError == true)
-    return;
-    interpreter interpreter1;
-    interpreter1.interpret(statements);
-}
-
-void run_file(const std::string& source)
-{
-    std::ifstream file(source, std::ios::binary);
-    if(!file)
-    {
-        std::cerr << "Unable to open file at given path : " << source << std::endl;
-        std::exit(65);
-    }
-    std::ostringstream buffer;
-    buffer << file.rdbuf();
-    run(buffer.str());
-}
-
-void run_prompt()
-{
-    std::string current;
-    for(;;)
-    {
-        std::cout << "> ";
-        std::cout.flush();
-        std::getline(std::cin, current);
-        if(current == "")
-        break;
-        run(current);
-    }
-}
-
-std::shared_ptr<Token> make_token(TokenType type, const std::string& lexeme)
-{
-    return std::make_shared<Token>(lexeme, std::any{}, type, 1);
-}
-
-void metal_error(std::shared_ptr<Token> token, const std::string& message)
-{
-    if(token->type == TokenType::EOF_TOKEN)
-    std::cerr << "Reached end of source program without completion of expression." << std::endl;
-    std::cerr << message << " at line " << token->line << std::endl;
-}
-
-void metal_runtime_error(const RuntimeError& error)
-{
-    std::cerr << error.what() << " at line : " << error.token->line << std::endl;
-    hadError = true;
-    return;
-}
-
-int main(int argc, char* argv[])
-{
-    if(argc > 2)
-    {
-        std::cout << "Usage error, exiting." << std::endl;
-        std::exit(64);
-    }
-    else if(argc == 2)
-    {
-        run_file(argv[1]);
-    }
-    else
-    {
-        run_prompt();
-    }
-}
\ No newline at end of file
+#include <new>
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdlib>
+#include <malloc.h>
+#include <algorithm>
+#include <iostream>
+#include "metal.hpp"
+#include "mapped_file.hpp"
+#include "script_cache.hpp"
+#include "memory_stats.hpp"
+
+bool useVM = false;
+bool showStats = false;
+bool optimize = false;
+int workers = 0;
+bool profiling = false;
+bool sampling = false;
+std::string foldedPath;
+std::string cacheDirectory;
+int jobs = 1;
+Limits limits;
+bool memoryStats = false;
+HeapUsage heap;
+
+void* operator new(size_t size)
+{
+    void* memory = std::malloc(size == 0 ? 1 : size);
+    if(memory == nullptr)
+    throw std::bad_alloc();
+    if(heap.tracking == true)
+    heap.allocated(malloc_usable_size(memory));
+    return memory;
+}
+void operator delete(void* memory) noexcept
+{
+    if(memory != nullptr && heap.tracking == true)
+    heap.freed(malloc_usable_size(memory));
+    std::free(memory);
+}
+void operator delete(void* memory, size_t) noexcept
+{
+    operator delete(memory);
+}
+
+void report(const Diagnostics& diagnostics)
+{
+    for(const Diagnostic& diagnostic : diagnostics)
+    {
+        switch(diagnostic.kind)
+        {
+            case Diagnostic::SCAN:
+            std::cerr << diagnostic.message << std::endl;
+            break;
+            case Diagnostic::PARSE:
+            if(diagnostic.atEnd == true)
+            std::cerr << "Reached end of source program without completion of expression." << std::endl;
+            std::cerr << diagnostic.message << " at line " << diagnostic.line << std::endl;
+            break;
+            case Diagnostic::RUNTIME:
+            std::cerr << diagnostic.message << " at line : " << diagnostic.line << std::endl;
+            break;
+        }
+    }
+}
+
+struct session
+{
+    Engine engine;
+    std::unordered_map<std::string_view, std::unique_ptr<Script>> cache;
+    Context context{engine};
+    session()
+    {
+        engine.useVM = useVM;
+        engine.optimize = optimize;
+        context.limits = limits;
+    }
+    void run_line(const std::string& line)
+    {
+        auto cached = cache.find(line);
+        if(cached != cache.end())
+        {
+            report(context.execute(*cached->second));
+            return;
+        }
+        std::unique_ptr<Script> script = engine.compile(line);
+        if(!script->ok())
+        {
+            report(script->diagnostics);
+            return;
+        }
+        const Script& compiled = *script;
+        cache.emplace(compiled.source, std::move(script));
+        report(context.execute(compiled));
+    }
+};
+
+bool run_compiled(std::string_view source, int parsers)
+{
+    Engine engine;
+    engine.useVM = useVM || !cacheDirectory.empty();
+    engine.optimize = optimize;
+    ScriptCache cache(cacheDirectory);
+    std::unique_ptr<Script> script;
+    if(!cacheDirectory.empty())
+    script = cache.load(engine, source);
+    if(script == nullptr)
+    {
+        script = engine.compile_view(source, parsers);
+        if(!cacheDirectory.empty() && script->ok())
+        cache.store(engine, *script, source);
+    }
+    if(!script->ok() && parsers == 1)
+    return false;
+    if(!script->ok())
+    {
+        report(script->diagnostics);
+        return true;
+    }
+    Context context(engine);
+    context.limits = limits;
+    report(context.execute(*script));
+    return true;
+}
+
+void run_measured(std::string_view source)
+{
+    memory_stats stats(heap);
+    Engine engine;
+    engine.useVM = useVM;
+    engine.optimize = optimize;
+    std::unique_ptr<Script> script = std::make_unique<Script>();
+    script->source = source;
+    script->arena.counts = &stats.nodes;
+    stats.begin("scan");
+    {
+        scanner scanner1(script->source, engine.symbols);
+        while(scanner1.next().type != TokenType::EOF_TOKEN)
+        stats.tokens++;
+    }
+    stats.end();
+    stats.begin("parse");
+    {
+        scanner scanner1(script->source, engine.symbols);
+        parser parser1(scanner1, script->arena, script->diagnostics);
+        script->statements = parser1.parse();
+    }
+    stats.end();
+    stats.begin("resolve");
+    {
+        optimizer optimizer1(script->arena, engine.folded);
+        fuser fuser1(script->arena, engine.fused);
+        for(Stmt*& statement : script->statements)
+        {
+            engine.resolver1.resolve(statement, script->diagnostics);
+            if(optimize == true)
+            statement = engine.rewrite(optimizer1, fuser1, statement);
+        }
+        engine.finish(*script);
+    }
+    stats.end();
+    stats.begin("execute");
+    {
+        Context context(engine);
+        context.limits = limits;
+        stats.diagnostics = context.execute(*script);
+    }
+    stats.end();
+    stats.arenaBytes = script->arena.bytes;
+    stats.arenaReserved = script->arena.reserved;
+    stats.write(std::cerr);
+}
+
+void run_file(const std::string& source)
+{
+    MappedFile file;
+    if(!file.open(source))
+    {
+        std::cerr << "Unable to open file at given path : " << source << std::endl;
+        std::exit(65);
+    }
+    if(memoryStats == true)
+    {
+        run_measured(file.view());
+        return;
+    }
+    Engine engine;
+    engine.useVM = useVM;
+    engine.optimize = optimize;
+    if(workers > 0)
+    {
+        std::unique_ptr<Script> script = engine.compile_view(file.view(), jobs);
+        if(!script->ok())
+        {
+            report(script->diagnostics);
+            return;
+        }
+        for(const Run& run : execute_concurrently(engine, *script, workers, limits))
+        {
+            std::cout << run.output;
+            report(run.diagnostics);
+        }
+        return;
+    }
+    bool parallel = jobs > 1 && file.size >= Engine::PARALLEL_THRESHOLD;
+    if(profiling == false && showStats == false && (parallel || !cacheDirectory.empty()) && run_compiled(file.view(), parallel ? jobs : 1))
+    return;
+    Arena arena;
+    Context context(engine);
+    context.limits = limits;
+    profiler profile;
+    if(profiling == true)
+    {
+        engine.useVM = false;
+        profile.sampling = sampling;
+        context.interpreter1.profile = &profile;
+        profile.start();
+    }
+    report(context.run(file.view(), arena));
+    if(profiling == true)
+    {
+        profile.stop();
+        profile.report(std::cerr, 10);
+        std::string folded = foldedPath.empty() ? source + ".folded" : foldedPath;
+        if(profile.write_folded(folded))
+        std::cerr << "folded stacks : " << folded << std::endl;
+        else
+        std::cerr << "Unable to write " << folded << std::endl;
+    }
+    if(showStats == true)
+    {
+        std::cerr << "nodes : " << arena.nodes << std::endl;
+        std::cerr << "arena bytes : " << arena.bytes << " (" << arena.reserved << " reserved)" << std::endl;
+        std::cerr << "folded nodes : " << engine.folded << std::endl;
+        std::cerr << "fused statements : " << engine.fused << std::endl;
+    }
+}
+
+void run_prompt()
+{
+    session session1;
+    std::string current;
+    for(;;)
+    {
+        std::cout << "> ";
+        std::cout.flush();
+        std::getline(std::cin, current);
+        if(current == "")
+        break;
+        session1.run_line(current);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    int arg = 1;
+    for(; arg < argc && argv[arg][0] == '-'; arg++)
+    {
+        std::string flag = argv[arg];
+        if(flag == "--vm")
+        useVM = true;
+        else if(flag == "-O")
+        optimize = true;
+        else if(flag == "--stats")
+        showStats = true;
+        else if(flag == "--mem-stats")
+        memoryStats = heap.tracking = true;
+        else if(flag == "--profile")
+        profiling = true;
+        else if(flag == "--profile=sample")
+        profiling = sampling = true;
+        else if(flag == "--folded" && arg + 1 < argc)
+        foldedPath = argv[++arg];
+        else if(flag == "--jobs" && arg + 1 < argc)
+        jobs = std::max(1, std::atoi(argv[++arg]));
+        else if(flag == "--cache" && arg + 1 < argc)
+        cacheDirectory = argv[++arg];
+        else if(flag == "--max-steps" && arg + 1 < argc)
+        limits.steps = std::strtoull(argv[++arg], nullptr, 10);
+        else if(flag == "--max-time" && arg + 1 < argc)
+        limits.milliseconds = std::strtoull(argv[++arg], nullptr, 10);
+        else if(flag == "--max-memory" && arg + 1 < argc)
+        limits.memory = std::strtoull(argv[++arg], nullptr, 10);
+        else if(flag == "--max-output" && arg + 1 < argc)
+        limits.output = std::strtoull(argv[++arg], nullptr, 10);
+        else if(flag == "--threads" && arg + 1 < argc)
+        workers = std::max(1, std::atoi(argv[++arg]));
+        else
+        {
+            std::cout << "Unknown option " << flag << ", exiting." << std::endl;
+            std::exit(64);
+        }
+    }
+    if(argc - arg > 1)
+    {
+        std::cout << "Usage error, exiting." << std::endl;
+        std::exit(64);
+    }
+    else if(argc - arg == 1)
+    {
+        run_file(argv[arg]);
+    }
+    else
+    {
+        run_prompt();
+    }
+}
@@ -0,0 +1,116 @@
+#ifndef fuser_hpp
+#define fuser_hpp
+#include "parser.hpp"
+
+struct fuser : public StmtVisitor
+{
+    Arena& arena;
+    size_t& fused;
+    Stmt* result = nullptr;
+    fuser(Arena& arena, size_t& fused):
+    arena(arena), fused(fused){}
+    Stmt* fuse(Stmt* statement)
+    {
+        result = statement;
+        statement->accept(*this);
+        return result;
+    }
+    template<typename T>
+    static T& edit(const T& node)
+    {
+        return const_cast<T&>(node);
+    }
+    static const Binary* simple(const Expr* expr)
+    {
+        const Binary* binary = dynamic_cast<const Binary*>(expr);
+        if(binary == nullptr || !binary->simple())
+        return nullptr;
+        return binary;
+    }
+    static bool same(const Binding& target, const Variable* variable)
+    {
+        return variable != nullptr && variable->binding.depth == target.depth && variable->binding.slot == target.slot;
+    }
+    static bool number(const Literal* literal)
+    {
+        return literal != nullptr && literal->value.isNumber();
+    }
+    void replace(const Stmt& original, Stmt* node)
+    {
+        fused++;
+        node->line = original.line;
+        result = node;
+    }
+    void store(const Stmt& original, const Binding& target, const Binary& value)
+    {
+        TokenType type = value.op->type;
+        if(type == TokenType::ADD || type == TokenType::SUB)
+        {
+            if(same(target, value.leftVariable) && number(value.rightLiteral))
+            {
+                double delta = value.rightLiteral->value.asNumber();
+                return replace(original, arena.make<Increment>(&target, &value, type == TokenType::SUB ? -delta : delta, result));
+            }
+            if(type == TokenType::ADD && same(target, value.rightVariable) && number(value.leftLiteral))
+            return replace(original, arena.make<Increment>(&target, &value, value.leftLiteral->value.asNumber(), result));
+        }
+        replace(original, arena.make<Store>(&target, &value, result));
+    }
+    void visitExpressionStmt(const Expression& stmt)
+    {
+        const Assign* assign = dynamic_cast<const Assign*>(stmt.expression);
+        if(assign == nullptr)
+        return;
+        if(const Binary* value = simple(assign->expression))
+        store(stmt, assign->binding, *value);
+    }
+    void visitPrintStmt(const Print& stmt)
+    {
+        if(const Binary* value = simple(stmt.printExpression))
+        replace(stmt, arena.make<PrintBinary>(value, result));
+    }
+    void visitVarStmt(const Var& stmt)
+    {
+        if(const Binary* value = simple(stmt.expression))
+        store(stmt, stmt.binding, *value);
+    }
+    void visitBlockStmt(const Block& stmt)
+    {
+        for(uint32_t i = 0; i < stmt.count; i++)
+        stmt.statements[i] = fuse(stmt.statements[i]);
+        result = &edit(stmt);
+    }
+    void visitIfStmt(const If& stmt)
+    {
+        If& node = edit(stmt);
+        node.thenBranch = fuse(node.thenBranch);
+        if(node.elseBranch != nullptr)
+        node.elseBranch = fuse(node.elseBranch);
+        result = &node;
+    }
+    void visitWhileStmt(const While& stmt)
+    {
+        While& node = edit(stmt);
+        node.body = fuse(node.body);
+        result = &node;
+    }
+    void visitFunctionStmt(const Function& stmt)
+    {
+        for(uint32_t i = 0; i < stmt.count; i++)
+        stmt.body[i] = fuse(stmt.body[i]);
+        result = &edit(stmt);
+    }
+    void visitReturnStmt(const Return&)
+    {
+    }
+    void visitIncrementStmt(const Increment&)
+    {
+    }
+    void visitStoreStmt(const Store&)
+    {
+    }
+    void visitPrintBinaryStmt(const PrintBinary&)
+    {
+    }
+};
+#endif
@@ -1,193 +1,320 @@
-#ifndef interpreter_hpp
-#define interpreter_hpp
-#include "parser.hpp"
-struct Environment;
-void metal_runtime_error(const RuntimeError& error);
-struct interpreter : public ExprVisitor, public StmtVisitor
-{
-    Environment environment;
-    void interpret(std::vector<std::shared_ptr<Stmt>> statements) 
-    {
-        try 
-        {
-            for(int i = 0; i < statements.size(); i++)
-            {
-                execute(statements[i]);
-            }
-        } 
-        catch (const RuntimeError& error) 
-        {
-            metal_runtime_error(error); 
-        }
-    }
-    void execute(std::shared_ptr<Stmt> stmt)
-    {
-        stmt->accept(*this);
-    }
-    std::string stringify(const std::any& value)
-    {
-        if(value.type() == typeid(nullptr))
-        return "nil";
-        if(value.type() == typeid(double))
-        {
-            std::string text = std::to_string(std::any_cast<double>(value));
-            if(text.size() > 2 && text.substr(text.size() - 2) == ".0")
-            text.erase(text.size() - 2);
-            return text;
-        }
-        if(value.type() == typeid(bool))
-        {
-            bool value1 = std::any_cast<bool>(value);
-            if(value1 == true)
-            return "true";
-            return "false";
-        }
-        if (value.type() == typeid(std::string)) 
-        {
-            return std::any_cast<std::string>(value);
-        }
-        return "????";
-    }
-    std::any visitBinaryExpr(const Binary& expr)
-    {
-        std::any left = evaluate(expr.left);
-        std::any right = evaluate(expr.right);
-        switch(expr.op->type)
-        {
-            case TokenType::ADD:
-            {
-                if(left.type() == typeid(double) && right.type() == typeid(double))
-                return std::any_cast<double>(left) + std::any_cast<double>(right);
-                if(left.type() == typeid(std::string) && right.type() == typeid(std::string))
-                return std::any_cast<std::string>(left) + std::any_cast<std::string>(right);
-                throw RuntimeError(expr.op, "Operands must be either strings or numbers.");
-            }
-            case TokenType::SUB:
-            checkNumberOperands(left, right, expr.op);
-            return std::any_cast<double>(left) - std::any_cast<double>(right);
-            case TokenType::MUL:
-            checkNumberOperands(left, right, expr.op);
-            return std::any_cast<double>(left) * std::any_cast<double>(right);
-            case TokenType::DIV:
-            checkNumberOperands(left, right, expr.op);
-            return std::any_cast<double>(left) / std::any_cast<double>(right);
-            case TokenType::GREATER:
-            checkNumberOperands(left, right, expr.op);
-            return std::any_cast<double>(left) > std::any_cast<double>(right);
-            case TokenType::GREATER_EQUAL:
-            checkNumberOperands(left, right, expr.op);
-            return std::any_cast<double>(left) >= std::any_cast<double>(right);
-            case TokenType::LESS:
-            checkNumberOperands(left, right, expr.op);
-            return std::any_cast<double>(left) < std::any_cast<double>(right);
-            case TokenType::LESS_EQUAL:
-            checkNumberOperands(left, right, expr.op);
-            return std::any_cast<double>(left) <= std::any_cast<double>(right);
-            case TokenType::NOT_EQUAL:
-            return !isEqual(left, right);
-            case TokenType::EQUAL_EQUAL:
-            return isEqual(left, right);
-            default:
-            throw RuntimeError(expr.op, "Unexpected binary operator.");
-        }
-    }
-    std::any visitUnaryExpr(const Unary& expr)
-    {
-        std::any right = evaluate(expr.right);
-        switch(expr.op->type)
-        {
-            case TokenType::SUB:
-            {
-                checkNumberOperand(expr.op, right);
-                return -std::any_cast<double>(right);
-            }
-            case TokenType::NOT:
-            {
-                return !isTrue(right);
-            }
-        }
-        throw RuntimeError(expr.op, "Unexpected unary operator.");
-    }
-    std::any visitLiteralExpr(const Literal& expr)
-    {
-        return expr.value;
-    }
-    std::any visitGroupingExpr(const Grouping& expr)
-    {
-        return evaluate(expr.expression);
-    }
-    std::any visitVariableExpr(const Variable& expr)
-    {
-        return environment.get(expr.token);
-    }
-    std::any visitAssignExpr(const Assign& expr)
-    {
-        std::any value = evaluate(expr.expression);
-        environment.assign(expr.token, value);
-        return value;
-    }
-    void visitExpressionStmt(const Expression& stmt)
-    {
-        evaluate(stmt.expression);
-        return;
-    }
-    void visitVarStmt(const Var& stmt)
-    {
-        std::any value = std::make_any<std::nullptr_t>(nullptr); 
-        if(stmt.expression != nullptr)
-        {
-            value = evaluate(stmt.expression);
-        }
-        environment.define(stmt.token->lexeme, value);
-        return;
-    }
-    void visitPrintStmt(const Print& stmt)
-    {
-        std::any value = evaluate(stmt.printExpression);
-        std::cout << stringify(value) << std::endl;
-        return;
-    }
-    std::any evaluate(std::shared_ptr<Expr> expr)
-    {
-        return expr->accept(*this);
-    }
-    bool isTrue(const std::any& expression)
-    {
-        if(expression.type() == typeid(nullptr))
-        return false;
-        if(expression.type() == typeid(bool))
-        return std::any_cast<bool>(expression);
-        return true;
-    }
-    bool isEqual(const std::any& a, const std::any& b) 
-    {
-        bool a_is_nil = (a.type() == typeid(nullptr));
-        bool b_is_nil = (b.type() == typeid(nullptr));
-        if (a_is_nil && b_is_nil) 
-        return true;
-        if (a_is_nil) 
-        return false;
-        if (a.type() != b.type())
-        return false;
-        if (a.type() == typeid(double))
-        return std::any_cast<double>(a) == std::any_cast<double>(b);
-        if (a.type() == typeid(bool))
-        return std::any_cast<bool>(a) == std::any_cast<bool>(b);
-        if (a.type() == typeid(std::string))
-        return std::any_cast<std::string>(a) == std::any_cast<std::string>(b);
-        return false;
-    }
-    void checkNumberOperand(std::shared_ptr<Token> token, const std::any& op)
-    {
-        if(op.type() == typeid(double))
-        return;
-        throw RuntimeError(token, "Operand must be a number.");
-    }
-    void checkNumberOperands(const std::any& operand1, const std::any& operand2, std::shared_ptr<Token> op)
-    {
-        if(operand1.type() == typeid(double) && operand2.type() == typeid(double))
-        return;
-        throw RuntimeError(op, "Operands must be numbers.");
-    }
-};
+#ifndef interpreter_hpp
+#define interpreter_hpp
+#include "parser.hpp"
+#include "output_sink.hpp"
+#include "profiler.hpp"
+#include "budget.hpp"
+struct interpreter : public ExprVisitor, public StmtVisitor
+{
+    static constexpr int MAX_CALL_DEPTH = 1000;
+    Environment& environment;
+    OutputSink* out;
+    profiler* profile = nullptr;
+    budget meter;
+    std::vector<Value> stack;
+    size_t base = 0;
+    size_t top = 0;
+    uint32_t scriptSlots = 0;
+    int calls = 0;
+    bool returning = false;
+    Value returnValue;
+    interpreter(Environment& globals, OutputSink& out):
+    environment(globals), out(&out){}
+    bool interpret(const std::vector<Stmt*>& statements, Diagnostics& diagnostics) 
+    {
+        for(size_t i = 0; i < statements.size(); i++)
+        {
+            if(interpret(statements[i], diagnostics) == false)
+            return false;
+        }
+        return true;
+    }
+    bool interpret(Stmt* statement, Diagnostics& diagnostics)
+    {
+        base = 0;
+        top = scriptSlots;
+        if(stack.size() < top)
+        stack.resize(top);
+        try 
+        {
+            execute(statement);
+            return true;
+        } 
+        catch (const RuntimeError& error) 
+        {
+            calls = 0;
+            returning = false;
+            returnValue = Value();
+            diagnostics.push_back(Diagnostic{Diagnostic::RUNTIME, error.line, error.what()});
+            return false;
+        }
+    }
+    Value& slot(const Binding& binding)
+    {
+        if(binding.depth == Binding::LOCAL)
+        return stack[base + binding.slot];
+        return environment.slots[binding.slot];
+    }
+    void checkpoint(int line)
+    {
+        if(const char* message = meter.charge())
+        throw RuntimeError(line, message);
+    }
+    void execute(Stmt* stmt)
+    {
+        try
+        {
+            if(profile != nullptr)
+            profiled(stmt);
+            else
+            stmt->accept(*this);
+        }
+        catch(const LimitError& error)
+        {
+            throw RuntimeError(stmt->line, error.what());
+        }
+    }
+    PROFILER_COLD void profiled(Stmt* stmt)
+    {
+        if(profile->sampling == true)
+        {
+            int outer = profile->line;
+            if(profiler::tick != 0)
+            profile->sample();
+            profile->line = stmt->line;
+            stmt->accept(*this);
+            if(profiler::tick != 0)
+            profile->sample();
+            profile->line = outer;
+            return;
+        }
+        uint64_t nodeChildren = profile->nodeChildren;
+        uint64_t lineChildren = profile->lineChildren;
+        profile->nodeChildren = 0;
+        profile->lineChildren = 0;
+        uint64_t start = profiler::now();
+        stmt->accept(*this);
+        uint64_t elapsed = profiler::now() - start;
+        profile->record(typeid(*stmt), elapsed, profile->nodeChildren);
+        profile->recordLine(stmt->line, elapsed, profile->lineChildren);
+        profile->nodeChildren = nodeChildren + elapsed;
+        profile->lineChildren = lineChildren + elapsed;
+    }
+    const Value& operand(Expr* expr, const Literal* literal, const Variable* variable, Value& scratch)
+    {
+        if(literal != nullptr)
+        return literal->value;
+        if(variable != nullptr)
+        return slot(variable->binding);
+        scratch = evaluate(expr);
+        return scratch;
+    }
+    Value visitBinaryExpr(const Binary& expr)
+    {
+        if(expr.pure() && profile == nullptr)
+        {
+            Value leftScratch;
+            Value rightScratch;
+            const Value& left = operand(expr.left, expr.leftLiteral, expr.leftVariable, leftScratch);
+            const Value& right = operand(expr.right, expr.rightLiteral, expr.rightVariable, rightScratch);
+            return expr.kernel(left, right, expr.op);
+        }
+        Value left = evaluate(expr.left);
+        Value right = evaluate(expr.right);
+        return expr.kernel(left, right, expr.op);
+    }
+    Value visitUnaryExpr(const Unary& expr)
+    {
+        Value right = evaluate(expr.right);
+        switch(expr.op->type)
+        {
+            case TokenType::SUB:
+            {
+                checkNumberOperand(expr.op, right);
+                return -right.asNumber();
+            }
+            case TokenType::NOT:
+            {
+                return !isTrue(right);
+            }
+            default:
+            break;
+        }
+        throw RuntimeError(expr.op, "Unexpected unary operator.");
+    }
+    Value visitLiteralExpr(const Literal& expr)
+    {
+        return expr.value;
+    }
+    Value visitGroupingExpr(const Grouping& expr)
+    {
+        return evaluate(expr.expression);
+    }
+    Value visitVariableExpr(const Variable& expr)
+    {
+        return slot(expr.binding);
+    }
+    Value visitAssignExpr(const Assign& expr)
+    {
+        Value value = evaluate(expr.expression);
+        slot(expr.binding) = value;
+        return value;
+    }
+    Value visitLogicalExpr(const Logical& expr)
+    {
+        Value left = evaluate(expr.left);
+        if(expr.op->type == TokenType::OR)
+        {
+            if(isTrue(left))
+            return left;
+        }
+        else if(!isTrue(left))
+        return left;
+        return evaluate(expr.right);
+    }
+    Value visitCallExpr(const Call& expr)
+    {
+        Value callee = evaluate(expr.callee);
+        size_t frame = top;
+        for(uint32_t i = 0; i < expr.count; i++)
+        {
+            Value argument = evaluate(expr.arguments[i]);
+            if(top == stack.size())
+            stack.resize(stack.size() * 2 + 16);
+            stack[top++] = std::move(argument);
+        }
+        if(!callee.isFunction())
+        throw RuntimeError(expr.paren, "Can only call functions.");
+        const Function* function = callee.asFunction();
+        if(expr.count != function->arity)
+        throw RuntimeError(expr.paren, "Expected " + std::to_string(function->arity) + " arguments but got " + std::to_string(expr.count) + ".");
+        if(calls >= MAX_CALL_DEPTH)
+        throw RuntimeError(expr.paren, "Stack overflow.");
+        if(meter.tick() == true)
+        checkpoint(expr.paren->line);
+        size_t end = frame + function->slots;
+        if(end > stack.size())
+        stack.resize(end * 2);
+        size_t caller = base;
+        base = frame;
+        top = end;
+        calls++;
+        if(profile != nullptr)
+        profile->enter(function);
+        for(uint32_t i = 0; i < function->count && returning == false; i++)
+        execute(function->body[i]);
+        if(profile != nullptr)
+        profile->leave();
+        calls--;
+        for(size_t i = frame; i < end; i++)
+        stack[i] = Value();
+        base = caller;
+        top = frame;
+        Value result;
+        if(returning == true)
+        {
+            result = std::move(returnValue);
+            returning = false;
+        }
+        return result;
+    }
+    void visitExpressionStmt(const Expression& stmt)
+    {
+        evaluate(stmt.expression);
+        return;
+    }
+    void visitVarStmt(const Var& stmt)
+    {
+        Value value;
+        if(stmt.expression != nullptr)
+        {
+            value = evaluate(stmt.expression);
+        }
+        slot(stmt.binding) = std::move(value);
+        return;
+    }
+    void visitBlockStmt(const Block& stmt)
+    {
+        for(uint32_t i = 0; i < stmt.count && returning == false; i++)
+        execute(stmt.statements[i]);
+    }
+    void visitIfStmt(const If& stmt)
+    {
+        if(isTrue(evaluate(stmt.condition)))
+        execute(stmt.thenBranch);
+        else if(stmt.elseBranch != nullptr)
+        execute(stmt.elseBranch);
+    }
+    void visitWhileStmt(const While& stmt)
+    {
+        while(returning == false && isTrue(evaluate(stmt.condition)))
+        {
+            execute(stmt.body);
+            if(meter.tick() == true)
+            checkpoint(stmt.line);
+        }
+    }
+    void visitFunctionStmt(const Function& stmt)
+    {
+        slot(stmt.binding) = Value(&stmt);
+    }
+    void visitReturnStmt(const Return& stmt)
+    {
+        if(stmt.value != nullptr)
+        returnValue = evaluate(stmt.value);
+        returning = true;
+    }
+    void visitPrintStmt(const Print& stmt)
+    {
+        Value value = evaluate(stmt.printExpression);
+        out->print(value);
+        return;
+    }
+    Value combine(const Binary& expr)
+    {
+        const Value& left = expr.leftLiteral != nullptr ? expr.leftLiteral->value : slot(expr.leftVariable->binding);
+        const Value& right = expr.rightLiteral != nullptr ? expr.rightLiteral->value : slot(expr.rightVariable->binding);
+        return expr.kernel(left, right, expr.op);
+    }
+    void visitIncrementStmt(const Increment& stmt)
+    {
+        Value& target = slot(*stmt.target);
+        if(target.isNumber())
+        target.as.number += stmt.delta;
+        else
+        target = combine(*stmt.update);
+    }
+    void visitStoreStmt(const Store& stmt)
+    {
+        Value value = combine(*stmt.value);
+        slot(*stmt.target) = std::move(value);
+    }
+    void visitPrintBinaryStmt(const PrintBinary& stmt)
+    {
+        out->print(combine(*stmt.value));
+    }
+    Value evaluate(Expr* expr)
+    {
+        if(profile != nullptr && profile->sampling == false)
+        return profiled(expr);
+        return expr->accept(*this);
+    }
+    PROFILER_COLD Value profiled(Expr* expr)
+    {
+        uint64_t nodeChildren = profile->nodeChildren;
+        profile->nodeChildren = 0;
+        uint64_t start = profiler::now();
+        Value value = expr->accept(*this);
+        uint64_t elapsed = profiler::now() - start;
+        profile->record(typeid(*expr), elapsed, profile->nodeChildren);
+        profile->nodeChildren = nodeChildren + elapsed;
+        return value;
+    }
+    void checkNumberOperand(const Token* token, const Value& op)
+    {
+        if(op.isNumber())
+        return;
+        throw RuntimeError(token, "Operand must be a number.");
+    }
+};
 #endif
\ No newline at end of file
@@ -0,0 +1,80 @@
+#ifndef mapped_file_hpp
+#define mapped_file_hpp
+#include <string>
+#include <string_view>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+struct MappedFile
+{
+    const char* data = nullptr;
+    size_t size = 0;
+    bool mapped = false;
+    std::string buffer;
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile()
+    {
+        if(mapped == true)
+        munmap(const_cast<char*>(data), size);
+    }
+    bool open(const std::string& path)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if(fd < 0)
+        return false;
+        struct stat info;
+        if(fstat(fd, &info) != 0)
+        {
+            ::close(fd);
+            return false;
+        }
+        if(!S_ISREG(info.st_mode) || info.st_size == 0)
+        {
+            bool ok = read(fd);
+            ::close(fd);
+            return ok;
+        }
+        size = info.st_size;
+        void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if(mapping == MAP_FAILED)
+        {
+            size = 0;
+            return false;
+        }
+        madvise(mapping, size, MADV_SEQUENTIAL);
+        data = static_cast<const char*>(mapping);
+        mapped = true;
+        return true;
+    }
+    bool read(int fd)
+    {
+        char block[64 * 1024];
+        for(;;)
+        {
+            ssize_t count = ::read(fd, block, sizeof(block));
+            if(count == 0)
+            break;
+            if(count < 0)
+            {
+                if(errno == EINTR)
+                continue;
+                return false;
+            }
+            buffer.append(block, count);
+        }
+        data = buffer.data();
+        size = buffer.size();
+        return true;
+    }
+    std::string_view view() const
+    {
+        return std::string_view(data, size);
+    }
+};
+#endif
@@ -0,0 +1,155 @@
+#ifndef memory_stats_hpp
+#define memory_stats_hpp
+#include <atomic>
+#include <ostream>
+#include <iomanip>
+#include <cstdio>
+#include "arena.hpp"
+#include "profiler.hpp"
+
+struct HeapUsage
+{
+    bool tracking = false;
+    std::atomic<size_t> allocations{0};
+    std::atomic<size_t> bytes{0};
+    std::atomic<long long> live{0};
+    std::atomic<long long> peak{0};
+    void allocated(size_t size)
+    {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        bytes.fetch_add(size, std::memory_order_relaxed);
+        long long now = live.fetch_add(size, std::memory_order_relaxed) + size;
+        if(now > peak.load(std::memory_order_relaxed))
+        peak.store(now, std::memory_order_relaxed);
+    }
+    void freed(size_t size)
+    {
+        live.fetch_sub(size, std::memory_order_relaxed);
+    }
+};
+
+struct MemoryPhase
+{
+    std::string name;
+    size_t allocations = 0;
+    size_t bytes = 0;
+    long long peak = 0;
+    size_t strings = 0;
+    size_t stringBytes = 0;
+    long long stringPeak = 0;
+};
+
+struct memory_stats
+{
+    HeapUsage& heap;
+    std::vector<MemoryPhase> phases;
+    AllocationCounts nodes;
+    size_t tokens = 0;
+    size_t arenaBytes = 0;
+    size_t arenaReserved = 0;
+    size_t allocations = 0;
+    size_t bytes = 0;
+    long long live = 0;
+    size_t strings = 0;
+    size_t stringBytes = 0;
+    long long stringLive = 0;
+    Diagnostics diagnostics;
+    memory_stats(HeapUsage& heap):
+    heap(heap){}
+    void begin(std::string name)
+    {
+        phases.emplace_back();
+        phases.back().name = std::move(name);
+        allocations = heap.allocations.load();
+        bytes = heap.bytes.load();
+        live = heap.live.load();
+        heap.peak.store(live);
+        StringObject::Usage& usage = StringObject::usage();
+        strings = usage.allocations;
+        stringBytes = usage.bytes;
+        stringLive = usage.live;
+        usage.peak = usage.live;
+    }
+    void end()
+    {
+        MemoryPhase& phase = phases.back();
+        phase.allocations = heap.allocations.load() - allocations;
+        phase.bytes = heap.bytes.load() - bytes;
+        phase.peak = heap.peak.load() - live;
+        const StringObject::Usage& usage = StringObject::usage();
+        phase.strings = usage.allocations - strings;
+        phase.stringBytes = usage.bytes - stringBytes;
+        phase.stringPeak = usage.peak - stringLive;
+    }
+    static double average(size_t bytes, size_t count)
+    {
+        return count == 0 ? 0.0 : (double)bytes / count;
+    }
+    static void quote(std::ostream& out, std::string_view text)
+    {
+        out << '"';
+        for(char c : text)
+        {
+            if(c == '"' || c == '\\')
+            out << '\\' << c;
+            else if((unsigned char)c < 0x20)
+            {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                out << escaped;
+            }
+            else
+            out << c;
+        }
+        out << '"';
+    }
+    static const char* kindName(Diagnostic::Kind kind)
+    {
+        switch(kind)
+        {
+            case Diagnostic::SCAN: return "scan";
+            case Diagnostic::PARSE: return "parse";
+            case Diagnostic::RUNTIME: return "runtime";
+        }
+        return "unknown";
+    }
+    void write(std::ostream& out) const
+    {
+        out << std::fixed << std::setprecision(1);
+        out << "{\n  \"phases\": [\n";
+        for(size_t i = 0; i < phases.size(); i++)
+        {
+            const MemoryPhase& phase = phases[i];
+            out << "    {\"phase\": \"" << phase.name << "\", \"allocations\": " << phase.allocations;
+            out << ", \"bytes\": " << phase.bytes << ", \"peak_bytes\": " << phase.peak;
+            out << ", \"average_bytes\": " << average(phase.bytes, phase.allocations);
+            out << ", \"strings\": " << phase.strings << ", \"string_bytes\": " << phase.stringBytes;
+            out << ", \"string_peak_bytes\": " << phase.stringPeak << "}";
+            out << (i + 1 < phases.size() ? "," : "") << "\n";
+        }
+        std::vector<std::pair<std::string, AllocationCount>> types;
+        for(const auto& entry : nodes)
+        types.emplace_back(profiler::kindName(entry.first), entry.second);
+        std::sort(types.begin(), types.end(), [](const auto& a, const auto& b){ return a.second.bytes > b.second.bytes; });
+        out << "  ],\n  \"nodes\": [\n";
+        for(size_t i = 0; i < types.size(); i++)
+        {
+            const AllocationCount& count = types[i].second;
+            out << "    {\"type\": \"" << types[i].first << "\", \"count\": " << count.count;
+            out << ", \"bytes\": " << count.bytes << ", \"average_bytes\": " << average(count.bytes, count.count) << "}";
+            out << (i + 1 < types.size() ? "," : "") << "\n";
+        }
+        out << "  ],\n  \"tokens\": {\"scanned\": " << tokens << ", \"token_bytes\": " << sizeof(Token) << "},\n";
+        out << "  \"arena\": {\"bytes\": " << arenaBytes << ", \"reserved\": " << arenaReserved << "},\n";
+        out << "  \"diagnostics\": [\n";
+        for(size_t i = 0; i < diagnostics.size(); i++)
+        {
+            const Diagnostic& diagnostic = diagnostics[i];
+            out << "    {\"kind\": \"" << kindName(diagnostic.kind) << "\", \"line\": " << diagnostic.line << ", \"message\": ";
+            quote(out, diagnostic.message);
+            out << "}" << (i + 1 < diagnostics.size() ? "," : "") << "\n";
+        }
+        out << "  ]\n}\n";
+    }
+};
+#endif
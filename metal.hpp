@@ -0,0 +1,294 @@
+#ifndef metal_hpp
+#define metal_hpp
+#include <memory>
+#include <thread>
+#include "interpreter.hpp"
+#include "resolver.hpp"
+#include "vm.hpp"
+#include "optimizer.hpp"
+#include "fuser.hpp"
+#include "parallel_parser.hpp"
+
+struct Script
+{
+    std::string text;
+    std::string_view source;
+    Arena arena;
+    std::vector<Arena> arenas;
+    std::vector<Stmt*> statements;
+    Chunk chunk;
+    uint32_t globals = 0;
+    uint32_t locals = 0;
+    Diagnostics diagnostics;
+    bool ok() const
+    {
+        return diagnostics.empty();
+    }
+};
+
+struct Engine
+{
+    static constexpr size_t PARALLEL_THRESHOLD = 1024 * 1024;
+    SymbolTable symbols;
+    resolver resolver1;
+    bool useVM = false;
+    bool optimize = false;
+    size_t folded = 0;
+    size_t fused = 0;
+    std::unique_ptr<Script> compile(std::string source, int workers = 1)
+    {
+        std::unique_ptr<Script> script = std::make_unique<Script>();
+        script->text = std::move(source);
+        script->source = script->text;
+        return compile(std::move(script), workers);
+    }
+    // parses source in place; the caller keeps it alive as long as the script
+    std::unique_ptr<Script> compile_view(std::string_view source, int workers = 1)
+    {
+        std::unique_ptr<Script> script = std::make_unique<Script>();
+        script->source = source;
+        return compile(std::move(script), workers);
+    }
+    std::unique_ptr<Script> compile(std::unique_ptr<Script> script, int workers)
+    {
+        resolver::Mark mark = resolver1.mark();
+        build(*script, workers);
+        if(!script->ok())
+        resolver1.rollback(mark);
+        return script;
+    }
+    void build(Script& script, int workers)
+    {
+        if(workers > 1 && script.source.size() >= PARALLEL_THRESHOLD && compile_parallel(script, workers))
+        return;
+        scanner scanner1(script.source, symbols);
+        parser parser1(scanner1, script.arena, script.diagnostics);
+        optimizer optimizer1(script.arena, folded);
+        fuser fuser1(script.arena, fused);
+        while(!parser1.isAtEnd())
+        {
+            Stmt* statement = parser1.declaration();
+            if(statement == nullptr)
+            continue;
+            resolver1.resolve(statement, script.diagnostics);
+            if(optimize == true)
+            statement = rewrite(optimizer1, fuser1, statement);
+            script.statements.push_back(statement);
+        }
+        finish(script);
+    }
+    bool compile_parallel(Script& script, int workers)
+    {
+        std::vector<std::unique_ptr<ParseChunk>> chunks = parallel_parser::parse(script.source, workers);
+        for(const std::unique_ptr<ParseChunk>& chunk : chunks)
+        {
+            if(!chunk->diagnostics.empty())
+            return false;
+        }
+        parallel_parser::merge(chunks, symbols);
+        optimizer optimizer1(script.arena, folded);
+        fuser fuser1(script.arena, fused);
+        script.arenas.reserve(chunks.size());
+        for(std::unique_ptr<ParseChunk>& chunk : chunks)
+        {
+            for(Stmt* statement : chunk->statements)
+            {
+                resolver1.resolve(statement, script.diagnostics);
+                if(optimize == true)
+                statement = rewrite(optimizer1, fuser1, statement);
+                script.statements.push_back(statement);
+            }
+            script.arenas.push_back(std::move(chunk->arena));
+        }
+        finish(script);
+        return true;
+    }
+    Stmt* rewrite(optimizer& optimizer1, fuser& fuser1, Stmt* statement)
+    {
+        optimizer1.optimize(statement);
+        if(useVM == true)
+        return statement;
+        return fuser1.fuse(statement);
+    }
+    void finish(Script& script)
+    {
+        resolver1.finish(script.diagnostics);
+        script.globals = resolver1.globalCount;
+        script.locals = resolver1.scriptSlots;
+        if(useVM == true && script.ok())
+        {
+            compiler compiler1(script.chunk);
+            compiler1.compile(script.statements);
+        }
+    }
+    uint32_t declare(std::string_view name)
+    {
+        return resolver1.declare(symbols.intern(name));
+    }
+    int32_t find(std::string_view name) const
+    {
+        auto symbol = symbols.ids.find(name);
+        if(symbol == symbols.ids.end())
+        return -1;
+        return resolver1.find(symbol->second);
+    }
+};
+
+struct Context
+{
+    Engine& engine;
+    Environment globals;
+    OutputSink sink;
+    Limits limits;
+    interpreter interpreter1{globals, sink};
+    vm vm1{globals, sink};
+    std::thread::id thread = std::this_thread::get_id();
+    Context(Engine& engine):
+    engine(engine){}
+    Context(const Context&) = delete;
+    Context& operator=(const Context&) = delete;
+    void output(int fd)
+    {
+        sink.redirect(fd);
+    }
+    void output(std::string& buffer)
+    {
+        sink.redirect(buffer);
+    }
+    void output(std::ostream& stream)
+    {
+        sink.redirect(stream);
+    }
+    void flush()
+    {
+        sink.flush();
+    }
+    void reserve(uint32_t count, uint32_t locals = 0)
+    {
+        if(globals.slots.size() < count)
+        globals.slots.resize(count);
+        if(interpreter1.scriptSlots < locals)
+        interpreter1.scriptSlots = locals;
+    }
+    bool owned() const
+    {
+        return std::this_thread::get_id() == thread;
+    }
+    Diagnostics foreign() const
+    {
+        return Diagnostics{Diagnostic{Diagnostic::RUNTIME, 0, "Context used from another thread."}};
+    }
+    void start()
+    {
+        interpreter1.meter.start(limits, sink);
+        vm1.meter.start(limits, sink);
+    }
+    void stop()
+    {
+        interpreter1.meter.stop();
+        vm1.meter.stop();
+    }
+    Diagnostics execute(const Script& script)
+    {
+        if(!owned())
+        return foreign();
+        if(!script.ok())
+        return script.diagnostics;
+        Diagnostics diagnostics;
+        reserve(script.globals, script.locals);
+        start();
+        if(script.chunk.code.empty())
+        interpreter1.interpret(script.statements, diagnostics);
+        else
+        vm1.interpret(script.chunk, diagnostics);
+        stop();
+        sink.flush();
+        return diagnostics;
+    }
+    Diagnostics run(std::string_view source, Arena& arena)
+    {
+        if(!owned())
+        return foreign();
+        Diagnostics diagnostics;
+        scanner scanner1(source, engine.symbols);
+        parser parser1(scanner1, arena, diagnostics);
+        optimizer optimizer1(arena, engine.folded);
+        fuser fuser1(arena, engine.fused);
+        Chunk chunk;
+        compiler compiler1(chunk);
+        start();
+        while(!parser1.isAtEnd())
+        {
+            Stmt* statement = parser1.declaration();
+            if(statement == nullptr)
+            continue;
+            engine.resolver1.resolve(statement, diagnostics);
+            if(!diagnostics.empty())
+            continue;
+            if(engine.optimize == true)
+            statement = engine.rewrite(optimizer1, fuser1, statement);
+            reserve(engine.resolver1.globalCount, engine.resolver1.scriptSlots);
+            bool ok;
+            if(engine.useVM == true)
+            {
+                size_t start = compiler1.compile(statement);
+                ok = vm1.interpret(chunk, diagnostics, start);
+            }
+            else
+            ok = interpreter1.interpret(statement, diagnostics);
+            if(ok == false)
+            break;
+        }
+        engine.resolver1.finish(diagnostics);
+        stop();
+        sink.flush();
+        return diagnostics;
+    }
+    void set(std::string_view name, Value value)
+    {
+        set(engine.declare(name), std::move(value));
+    }
+    void set(int32_t slot, Value value)
+    {
+        if(slot < 0 || !owned())
+        return;
+        reserve(slot + 1);
+        globals.slots[slot] = std::move(value);
+    }
+    Value get(std::string_view name) const
+    {
+        return get(engine.find(name));
+    }
+    Value get(int32_t slot) const
+    {
+        if(slot < 0 || (size_t)slot >= globals.slots.size() || !owned())
+        return Value();
+        return globals.slots[slot];
+    }
+};
+
+struct Run
+{
+    std::string output;
+    Diagnostics diagnostics;
+};
+
+inline std::vector<Run> execute_concurrently(Engine& engine, const Script& script, int workers, const Limits& limits = Limits())
+{
+    std::vector<Run> runs(workers);
+    std::vector<std::thread> threads;
+    for(int i = 0; i < workers; i++)
+    {
+        threads.emplace_back([&engine, &script, &runs, &limits, i]()
+        {
+            Context context(engine);
+            context.limits = limits;
+            context.output(runs[i].output);
+            runs[i].diagnostics = context.execute(script);
+        });
+    }
+    for(std::thread& thread : threads)
+    thread.join();
+    return runs;
+}
+#endif
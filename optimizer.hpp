@@ -0,0 +1,224 @@
+#ifndef optimizer_hpp
+#define optimizer_hpp
+#include "parser.hpp"
+
+struct optimizer : public ExprVisitor, public StmtVisitor
+{
+    Arena& arena;
+    size_t& folded;
+    Expr* result = nullptr;
+    optimizer(Arena& arena, size_t& folded):
+    arena(arena), folded(folded){}
+    void optimize(Stmt* statement)
+    {
+        statement->accept(*this);
+    }
+    Expr* optimize(Expr* expr)
+    {
+        if(expr == nullptr)
+        return nullptr;
+        result = expr;
+        expr->accept(*this);
+        return result;
+    }
+    template<typename T>
+    static T& edit(const T& node)
+    {
+        return const_cast<T&>(node);
+    }
+    static const Literal* literal(const Expr* expr)
+    {
+        return dynamic_cast<const Literal*>(expr);
+    }
+    static bool isBoolean(const Expr* expr)
+    {
+        if(const Literal* constant = literal(expr))
+        return constant->value.isBool();
+        if(const Unary* unary = dynamic_cast<const Unary*>(expr))
+        return unary->op->type == TokenType::NOT;
+        if(const Binary* binary = dynamic_cast<const Binary*>(expr))
+        {
+            switch(binary->op->type)
+            {
+                case TokenType::GREATER: case TokenType::GREATER_EQUAL:
+                case TokenType::LESS: case TokenType::LESS_EQUAL:
+                case TokenType::EQUAL_EQUAL: case TokenType::NOT_EQUAL:
+                return true;
+                default:
+                return false;
+            }
+        }
+        return false;
+    }
+    Expr* fold(Value value)
+    {
+        folded++;
+        if(value.isString())
+        {
+            StringObject* text = arena.create<StringObject>(value.asString());
+            return arena.make<Literal>(Value::constant(text));
+        }
+        return arena.make<Literal>(std::move(value));
+    }
+    Value visitBinaryExpr(const Binary& expr)
+    {
+        Binary& node = edit(expr);
+        node.left = optimize(node.left);
+        node.right = optimize(node.right);
+        node.specialize();
+        result = &node;
+        const Literal* left = literal(node.left);
+        const Literal* right = literal(node.right);
+        if(left == nullptr || right == nullptr)
+        return Value();
+        const Value& a = left->value;
+        const Value& b = right->value;
+        switch(node.op->type)
+        {
+            case TokenType::EQUAL_EQUAL: result = fold(isEqual(a, b)); return Value();
+            case TokenType::NOT_EQUAL: result = fold(!isEqual(a, b)); return Value();
+            case TokenType::ADD:
+            if(a.isString() && b.isString())
+            {
+                result = fold(a.asString() + b.asString());
+                return Value();
+            }
+            break;
+            default:
+            break;
+        }
+        if(!a.isNumber() || !b.isNumber())
+        return Value();
+        double x = a.asNumber();
+        double y = b.asNumber();
+        switch(node.op->type)
+        {
+            case TokenType::ADD: result = fold(x + y); break;
+            case TokenType::SUB: result = fold(x - y); break;
+            case TokenType::MUL: result = fold(x * y); break;
+            case TokenType::DIV: result = fold(x / y); break;
+            case TokenType::GREATER: result = fold(x > y); break;
+            case TokenType::GREATER_EQUAL: result = fold(x >= y); break;
+            case TokenType::LESS: result = fold(x < y); break;
+            case TokenType::LESS_EQUAL: result = fold(x <= y); break;
+            default: break;
+        }
+        return Value();
+    }
+    Value visitUnaryExpr(const Unary& expr)
+    {
+        Unary& node = edit(expr);
+        node.right = optimize(node.right);
+        result = &node;
+        if(const Literal* operand = literal(node.right))
+        {
+            if(node.op->type == TokenType::NOT)
+            result = fold(!isTrue(operand->value));
+            else if(node.op->type == TokenType::SUB && operand->value.isNumber())
+            result = fold(-operand->value.asNumber());
+            return Value();
+        }
+        if(node.op->type == TokenType::NOT)
+        {
+            const Unary* inner = dynamic_cast<const Unary*>(node.right);
+            if(inner != nullptr && inner->op->type == TokenType::NOT && isBoolean(inner->right))
+            {
+                folded++;
+                result = inner->right;
+            }
+        }
+        return Value();
+    }
+    Value visitLiteralExpr(const Literal&)
+    {
+        return Value();
+    }
+    Value visitGroupingExpr(const Grouping& expr)
+    {
+        folded++;
+        result = optimize(expr.expression);
+        return Value();
+    }
+    Value visitVariableExpr(const Variable&)
+    {
+        return Value();
+    }
+    Value visitAssignExpr(const Assign& expr)
+    {
+        Assign& node = edit(expr);
+        node.expression = optimize(node.expression);
+        result = &node;
+        return Value();
+    }
+    Value visitLogicalExpr(const Logical& expr)
+    {
+        Logical& node = edit(expr);
+        node.left = optimize(node.left);
+        node.right = optimize(node.right);
+        result = &node;
+        if(const Literal* left = literal(node.left))
+        {
+            folded++;
+            bool taken = isTrue(left->value) == (node.op->type == TokenType::OR);
+            result = taken ? node.left : node.right;
+        }
+        return Value();
+    }
+    Value visitCallExpr(const Call& expr)
+    {
+        Call& node = edit(expr);
+        node.callee = optimize(node.callee);
+        for(uint32_t i = 0; i < node.count; i++)
+        node.arguments[i] = optimize(node.arguments[i]);
+        result = &node;
+        return Value();
+    }
+    void visitExpressionStmt(const Expression& stmt)
+    {
+        edit(stmt).expression = optimize(stmt.expression);
+    }
+    void visitPrintStmt(const Print& stmt)
+    {
+        edit(stmt).printExpression = optimize(stmt.printExpression);
+    }
+    void visitVarStmt(const Var& stmt)
+    {
+        edit(stmt).expression = optimize(stmt.expression);
+    }
+    void visitBlockStmt(const Block& stmt)
+    {
+        for(uint32_t i = 0; i < stmt.count; i++)
+        optimize(stmt.statements[i]);
+    }
+    void visitIfStmt(const If& stmt)
+    {
+        edit(stmt).condition = optimize(stmt.condition);
+        optimize(stmt.thenBranch);
+        if(stmt.elseBranch != nullptr)
+        optimize(stmt.elseBranch);
+    }
+    void visitWhileStmt(const While& stmt)
+    {
+        edit(stmt).condition = optimize(stmt.condition);
+        optimize(stmt.body);
+    }
+    void visitFunctionStmt(const Function& stmt)
+    {
+        for(uint32_t i = 0; i < stmt.count; i++)
+        optimize(stmt.body[i]);
+    }
+    void visitReturnStmt(const Return& stmt)
+    {
+        edit(stmt).value = optimize(stmt.value);
+    }
+    void visitIncrementStmt(const Increment&)
+    {
+    }
+    void visitStoreStmt(const Store&)
+    {
+    }
+    void visitPrintBinaryStmt(const PrintBinary&)
+    {
+    }
+};
+#endif
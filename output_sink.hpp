@@ -0,0 +1,126 @@
+#ifndef output_sink_hpp
+#define output_sink_hpp
+#include <string>
+#include <string_view>
+#include <ostream>
+#include <cerrno>
+#include <unistd.h>
+#include "parser.hpp"
+
+struct OutputSink
+{
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+    enum Target { DESCRIPTOR, MEMORY, STREAM };
+    Target target = DESCRIPTOR;
+    int fd = STDOUT_FILENO;
+    std::string* memory = nullptr;
+    std::ostream* stream = nullptr;
+    bool interactive = false;
+    std::string buffer;
+    size_t written = 0;
+    size_t ceiling = 0;
+    OutputSink()
+    {
+        redirect(STDOUT_FILENO);
+    }
+    OutputSink(const OutputSink&) = delete;
+    OutputSink& operator=(const OutputSink&) = delete;
+    ~OutputSink()
+    {
+        flush();
+    }
+    void redirect(int descriptor)
+    {
+        flush();
+        target = DESCRIPTOR;
+        fd = descriptor;
+        interactive = isatty(descriptor) == 1;
+    }
+    void redirect(std::string& text)
+    {
+        flush();
+        target = MEMORY;
+        memory = &text;
+        interactive = false;
+    }
+    void redirect(std::ostream& output)
+    {
+        flush();
+        target = STREAM;
+        stream = &output;
+        interactive = false;
+    }
+    void charge(size_t size)
+    {
+        if(ceiling != 0 && written + size > ceiling)
+        throw LimitError("Output limit exceeded.");
+        written += size;
+    }
+    void write(std::string_view text)
+    {
+        charge(text.size());
+        append(text);
+    }
+    void append(std::string_view text)
+    {
+        if(target == MEMORY)
+        {
+            memory->append(text);
+            return;
+        }
+        if(buffer.capacity() < BLOCK_SIZE)
+        buffer.reserve(BLOCK_SIZE);
+        buffer.append(text);
+        if(buffer.size() >= BLOCK_SIZE)
+        flush();
+    }
+    void line(std::string_view text)
+    {
+        charge(text.size() + 1);
+        append(text);
+        append("\n");
+        if(interactive == true)
+        flush();
+    }
+    void print(const Value& value)
+    {
+        if(value.isString())
+        line(value.asString());
+        else if(value.isNumber())
+        {
+            char buffer[32];
+            line(std::string_view(buffer, formatNumber(buffer, value.asNumber()) - buffer));
+        }
+        else
+        line(stringify(value));
+    }
+    void flush()
+    {
+        if(buffer.empty())
+        return;
+        if(target == STREAM)
+        {
+            stream->write(buffer.data(), buffer.size());
+            stream->flush();
+        }
+        else
+        {
+            const char* data = buffer.data();
+            size_t left = buffer.size();
+            while(left > 0)
+            {
+                ssize_t written = ::write(fd, data, left);
+                if(written < 0)
+                {
+                    if(errno == EINTR)
+                    continue;
+                    break;
+                }
+                data += written;
+                left -= written;
+            }
+        }
+        buffer.clear();
+    }
+};
+#endif
@@ -0,0 +1,122 @@
+#ifndef parallel_parser_hpp
+#define parallel_parser_hpp
+#include <atomic>
+#include <thread>
+#include "parser.hpp"
+
+struct ParseChunk
+{
+    std::string_view text;
+    int line = 1;
+    SymbolTable symbols;
+    Arena arena;
+    Diagnostics diagnostics;
+    std::vector<Stmt*> statements;
+    std::vector<Token*> identifiers;
+};
+
+struct parallel_parser
+{
+    static constexpr size_t CHUNKS_PER_WORKER = 4;
+    static constexpr size_t MIN_CHUNK_SIZE = 64 * 1024;
+    static bool startsElse(std::string_view source, size_t at)
+    {
+        while(at < source.size() && scanner::classOf(source[at]) == scanner::SPACE)
+        at++;
+        if(source.compare(at, 4, "else") != 0)
+        return false;
+        return at + 4 >= source.size() || (scanner::classOf(source[at + 4]) & (scanner::ALPHA | scanner::DIGIT)) == 0;
+    }
+    static std::vector<std::unique_ptr<ParseChunk>> split(std::string_view source, size_t parts)
+    {
+        std::vector<std::unique_ptr<ParseChunk>> chunks;
+        size_t step = std::max(MIN_CHUNK_SIZE, source.size() / std::max<size_t>(parts, 1));
+        size_t begin = 0;
+        int beginLine = 1;
+        int line = 1;
+        int depth = 0;
+        bool quoted = false;
+        for(size_t at = 0; at < source.size(); at++)
+        {
+            char ch = source[at];
+            if(ch == '\n')
+            {
+                line++;
+                continue;
+            }
+            if(quoted == true)
+            {
+                quoted = ch != '"';
+                continue;
+            }
+            switch(ch)
+            {
+                case '"': quoted = true; break;
+                case '(': case '{': depth++; break;
+                case ')': case '}': depth--; break;
+                case ';':
+                if(depth == 0 && at + 1 - begin >= step && !startsElse(source, at + 1))
+                {
+                    chunks.push_back(std::make_unique<ParseChunk>());
+                    chunks.back()->text = source.substr(begin, at + 1 - begin);
+                    chunks.back()->line = beginLine;
+                    begin = at + 1;
+                    beginLine = line;
+                }
+                break;
+            }
+        }
+        if(begin < source.size() || chunks.empty())
+        {
+            chunks.push_back(std::make_unique<ParseChunk>());
+            chunks.back()->text = source.substr(begin);
+            chunks.back()->line = beginLine;
+        }
+        return chunks;
+    }
+    static void parse(ParseChunk& chunk)
+    {
+        scanner scanner1(chunk.text, chunk.symbols);
+        scanner1.line = chunk.line;
+        parser parser1(scanner1, chunk.arena, chunk.diagnostics);
+        parser1.identifiers = &chunk.identifiers;
+        chunk.statements = parser1.parse();
+    }
+    static std::vector<std::unique_ptr<ParseChunk>> parse(std::string_view source, int workers)
+    {
+        std::vector<std::unique_ptr<ParseChunk>> chunks = split(source, workers * CHUNKS_PER_WORKER);
+        std::atomic<size_t> next{0};
+        auto work = [&chunks, &next]()
+        {
+            for(size_t i = next++; i < chunks.size(); i = next++)
+            parse(*chunks[i]);
+        };
+        std::vector<std::thread> threads;
+        for(int i = 1; i < workers && (size_t)i < chunks.size(); i++)
+        threads.emplace_back(work);
+        work();
+        for(std::thread& thread : threads)
+        thread.join();
+        return chunks;
+    }
+    static void merge(std::vector<std::unique_ptr<ParseChunk>>& chunks, SymbolTable& symbols)
+    {
+        size_t names = symbols.ids.size();
+        for(const std::unique_ptr<ParseChunk>& chunk : chunks)
+        names += chunk->symbols.names.size();
+        symbols.ids.reserve(names);
+        std::vector<uint32_t> ids;
+        for(std::unique_ptr<ParseChunk>& chunk : chunks)
+        {
+            ids.resize(chunk->symbols.names.size());
+            for(size_t i = 0; i < ids.size(); i++)
+            ids[i] = symbols.intern(chunk->symbols.names[i]);
+            for(Token* token : chunk->identifiers)
+            {
+                if(token->type == TokenType::IDENTIFIER)
+                token->symbol = ids[token->symbol];
+            }
+        }
+    }
+};
+#endif
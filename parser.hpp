@@ -1,416 +1,930 @@
-#ifndef parser_hpp
-#define parser_hpp
-#include "scanner.hpp"
-struct Expr;
-struct Binary;
-struct Assign;
-struct Unary;
-struct Grouping;
-struct Literal;
-struct Variable;
-struct ExprVisitor;
-struct Stmt;
-struct Print;
-struct Var;
-struct Expression;
-struct StmtVisitor;
-struct Environment;
-class RuntimeError; 
-void metal_error(std::shared_ptr<Token> token, const std::string& message);
-void metal_runtime_error(const RuntimeError& error);
-class ParseError : public std::runtime_error
-{
-    public:
-    ParseError():
-    std::runtime_error(""){}
-};
-class RuntimeError : public std::runtime_error 
-{
-    public:
-    std::shared_ptr<Token> token;
-    RuntimeError(std::shared_ptr<Token> token, const std::string& message):
-    std::runtime_error(message), token(token){}
-};
-struct Environment
-{
-    std::unordered_map<std::string, std::any> values;
-    void define(std::string name, std::any value)
-    {
-        values[name] = value;
-    }
-    std::any get(const std::shared_ptr<Token>& token)
-    {
-        auto value = values.find(token->lexeme);
-        if(value != values.end())
-        return value->second;
-        else
-        throw RuntimeError(token, "Undefined Variable");
-    }
-    void assign(const std::shared_ptr<Token>& token, std::any value)
-    {
-        if (values.count(token->lexeme)) 
-        {
-            values[token->lexeme] = value;
-            return;
-        }
-        throw RuntimeError(token, 
-        "Undefined variable '" + token->lexeme + "'.");
-    }
-};
-struct Expr
-{
-    virtual ~Expr() = default;
-    virtual std::any accept(ExprVisitor& visitor) = 0;
-};
-struct ExprVisitor 
-{
-    virtual ~ExprVisitor() = default;
-    virtual std::any visitUnaryExpr(const Unary& expr) = 0;
-    virtual std::any visitBinaryExpr(const Binary& expr) = 0;
-    virtual std::any visitAssignExpr(const Assign& expr) = 0;
-    virtual std::any visitLiteralExpr(const Literal& expr) = 0;
-    virtual std::any visitGroupingExpr(const Grouping& expr) = 0;
-    virtual std::any visitVariableExpr(const Variable& expr) = 0;
-};
-struct Binary : Expr
-{
-    std::shared_ptr<Expr> left;
-    std::shared_ptr<Token> op;
-    std::shared_ptr<Expr> right;
-    Binary(std::shared_ptr<Expr> left, std::shared_ptr<Token> op, std::shared_ptr<Expr> right):
-    left(left), op(op), right(right){}
-    std::any accept(ExprVisitor& visitor)
-    {
-        return visitor.visitBinaryExpr(*this);
-    }
-};
-struct Unary : Expr 
-{
-    std::shared_ptr<Token> op;
-    std::shared_ptr<Expr> right;
-    Unary(std::shared_ptr<Token> op, std::shared_ptr<Expr> right):
-    op(op), right(right){};
-    std::any accept(ExprVisitor& visitor)
-    {
-        return visitor.visitUnaryExpr(*this);
-    }
-};
-struct Grouping : Expr 
-{
-    std::shared_ptr<Expr> expression;
-    Grouping(std::shared_ptr<Expr> expression):
-    expression(expression){}
-    std::any accept(ExprVisitor& visitor)
-    {
-        return visitor.visitGroupingExpr(*this);
-    }
-};
-struct Literal : Expr 
-{
-    std::any value;
-    Literal(std::any value):
-    value(value){}
-    std::any accept(ExprVisitor& visitor)
-    {
-        return visitor.visitLiteralExpr(*this);
-    }
-};
-struct Variable : Expr 
-{
-    std::shared_ptr<Token> token;
-    Variable(std::shared_ptr<Token> token):
-    token(token){}
-    std::any accept(ExprVisitor& visitor)
-    {
-        return visitor.visitVariableExpr(*this);
-    }
-};
-struct Assign : Expr 
-{
-    std::shared_ptr<Token> token;
-    std::shared_ptr<Expr> expression;
-    Assign(std::shared_ptr<Token> token, std::shared_ptr<Expr> expression):
-    token(token), expression(expression){}
-    std::any accept(ExprVisitor& visitor)
-    {
-        return visitor.visitAssignExpr(*this);
-    }
-};
-
-struct Stmt
-{
-    virtual ~Stmt() = default;
-    virtual void accept(StmtVisitor& visitor) = 0;
-};
-struct StmtVisitor
-{
-    virtual ~StmtVisitor() = default;
-    virtual void visitExpressionStmt(const Expression& stmt) = 0;
-    virtual void visitPrintStmt(const Print& stmt) = 0;
-    virtual void visitVarStmt(const Var& stmt) = 0;
-};
-struct Expression : Stmt 
-{
-    std::shared_ptr<Expr> expression;
-    Expression(std::shared_ptr<Expr> expression):
-    expression(expression){}
-    void accept(StmtVisitor& visitor)
-    {
-        visitor.visitExpressionStmt(*this);
-    }
-};
-struct Print : Stmt
-{
-    std::shared_ptr<Expr> printExpression;
-    Print(std::shared_ptr<Expr> printExpression):
-    printExpression(printExpression){}
-    void accept(StmtVisitor& visitor)
-    {
-        visitor.visitPrintStmt(*this);
-    }
-};
-struct Var : Stmt 
-{
-    std::shared_ptr<Token> token;
-    std::shared_ptr<Expr> expression;
-    Var(std::shared_ptr<Token> token, std::shared_ptr<Expr> expression):
-    token(token), expression(expression){}
-    void accept(StmtVisitor& visitor)
-    {
-        visitor.visitVarStmt(*this);
-    }
-};
-
-struct parser
-{
-    std::vector<std::shared_ptr<Token>> tokens;
-    int current = 0;
-    parser(std::vector<std::shared_ptr<Token>> tokens):
-    tokens(tokens){}
-    std::vector<std::shared_ptr<Stmt>> parse() 
-    {
-        std::vector<std::shared_ptr<Stmt>> statements;
-        while(!isAtEnd())
-        {
-            statements.push_back(declaration());
-        }    
-        return statements;
-    }
-    std::shared_ptr<Stmt> declaration()
-    {
-        try 
-        {
-            if(match(TokenType::VAR) == true)
-            {
-                return varDeclaration();
-            }
-            return statement();
-        }
-        catch(RuntimeError)
-        {
-            synchronize();
-            return nullptr;
-        }
-    }
-    std::shared_ptr<Stmt> varDeclaration()
-    {
-        std::shared_ptr<Token> name = consume(TokenType::IDENTIFIER, "Expected variable name.");
-        std::shared_ptr<Expr> initializer = nullptr;
-        if(match(TokenType::EQUAL) == true)
-        {
-            initializer = expression();
-        }
-        consume(TokenType::SEMICOLON, "Expected a ';' after end of variable statement.");
-        return std::make_shared<Var>(name, initializer);
-    }
-    std::shared_ptr<Stmt> statement()
-    {
-        if(match(TokenType::PRINT) == true)
-        return printStatement();
-        return expressionStatement();
-    }
-    std::shared_ptr<Stmt> printStatement()
-    {
-        std::shared_ptr<Expr> pexpression = expression();
-        consume(TokenType::SEMICOLON, "Expected a semicolon after print statement.");
-        return std::make_shared<Print>(pexpression);
-    }
-    std::shared_ptr<Stmt> expressionStatement()
-    {
-        std::shared_ptr<Expr> eexpression = expression();
-        consume(TokenType::SEMICOLON, "Expected a semicolon after expression statement.");
-        return std::make_shared<Expression>(eexpression);
-    }
-    std::shared_ptr<Expr> expression()
-    {
-        return assignment();
-    }
-    std::shared_ptr<Expr> assignment()
-    {
-        std::shared_ptr<Expr> expression = equality();
-        {
-            if(match(TokenType::EQUAL) == true)
-            {
-                std::shared_ptr<Token> token = previous();
-                std::shared_ptr<Expr> value = assignment();
-                std::shared_ptr<Variable> varExpr = std::dynamic_pointer_cast<Variable>(expression);
-                if(varExpr != nullptr)
-                {
-                    std::shared_ptr<Token> name = varExpr->token;
-                    return std::make_shared<Assign>(name, value);
-                }
-                error(token, "Invalid Assignment Target.");
-            }
-        }
-        return expression;
-    }
-    std::shared_ptr<Expr> equality()
-    {
-        std::shared_ptr<Expr> left = comparison();
-        while((match(TokenType::NOT_EQUAL)) || (match(TokenType::EQUAL_EQUAL)))
-        {
-            std::shared_ptr<Token> op = previous();
-            std::shared_ptr<Expr> right = comparison();
-            left = std::make_shared<Binary>(left, op, right);
-        }
-        return left;
-    }
-    std::shared_ptr<Expr> comparison()
-    {
-        std::shared_ptr<Expr> left = term();
-        while(match(TokenType::GREATER_EQUAL) || match(TokenType::GREATER) || match(TokenType::LESS_EQUAL) || match(TokenType::LESS))
-        {
-            std::shared_ptr<Token> op = previous();
-            std::shared_ptr<Expr> right = term();
-            left = std::make_shared<Binary>(left, op, right);
-        }
-        return left;
-    }
-    std::shared_ptr<Expr> term()
-    {
-        std::shared_ptr<Expr> left = factor();
-        while(match(TokenType::ADD) || match(TokenType::SUB))
-        {
-            std::shared_ptr<Token> op = previous();
-            std::shared_ptr<Expr> right = factor();
-            left = std::make_shared<Binary>(left, op, right);
-        }
-        return left;
-    }
-    std::shared_ptr<Expr> factor()
-    {
-        std::shared_ptr<Expr> left = unary();
-        while(match(TokenType::MUL) || match(TokenType::DIV))
-        {
-            std::shared_ptr<Token> op = previous();
-            std::shared_ptr<Expr> right = unary();
-            left = std::make_shared<Binary>(left, op, right);
-        }
-        return left;
-    }
-    std::shared_ptr<Expr> unary()
-    {
-        if(match(TokenType::SUB) || match(TokenType::NOT))
-        {
-            std::shared_ptr<Token> op = previous();
-            std::shared_ptr<Expr> right = unary();
-            return std::make_shared<Unary>(op, right);
-        }
-        return primary();
-    }
-    std::shared_ptr<Expr> primary()
-    {
-        if(match(TokenType::FALSE)) return std::make_shared<Literal>(false);
-        if(match(TokenType::TRUE)) return std::make_shared<Literal>(true);
-        if(match(TokenType::NIL)) return std::make_shared<Literal>(nullptr);
-        if(match(TokenType::STRING) || match(TokenType::NUMBER)) return std::make_shared<Literal>(previous()->literal);
-        if (match(LEFT_PAREN)) 
-        {
-            std::shared_ptr<Expr> gexpression = expression();
-            consume(TokenType::RIGHT_PAREN, "Expect ')' after expression.");
-            return std::make_shared<Grouping>(gexpression);
-        }
-        if(match(TokenType::IDENTIFIER)) return std::make_shared<Variable>(previous());
-        throw error(peek(), "Expected an Expression.");
-    }
-
-    ParseError error(std::shared_ptr<Token> token, const std::string& message)
-    {
-        metal_error(token, message);
-        return ParseError();
-    }
-
-    std::shared_ptr<Token> consume(TokenType type, const std::string& message)
-    {
-        if(check(type)) return advance();
-        throw error(peek(), message);
-    }
-
-    bool match(TokenType type)
-    {
-        if(check(type) == true)
-        {
-            advance();
-            return true;
-        }
-        return false;
-    }
-
-    bool check(TokenType type)
-    {
-        if(isAtEnd() == true)
-        return false;
-        if(peek()->type != type)
-        return false;
-        return true;
-    }
-
-    std::shared_ptr<Token> advance()
-    {
-        if(!isAtEnd())
-        current++;
-        return previous();
-    }
-
-    bool isAtEnd()
-    {
-        if(peek()->type == TokenType::EOF_TOKEN)
-        {
-            return true;
-        }
-        return false;
-    }
-
-    std::shared_ptr<Token> peek()
-    {
-        return tokens[current];
-    }
-
-    std::shared_ptr<Token> previous()
-    {
-        return tokens[current - 1];
-    }
-    void synchronize() 
-    {
-        advance();
-        while (!isAtEnd()) 
-        {
-            if (previous()->type == TokenType::SEMICOLON) 
-            return;
-            switch (peek()->type) 
-            {
-            case TokenType::FUN:
-            case TokenType::VAR:
-            case TokenType::FOR:
-            case TokenType::IF:
-            case TokenType::WHILE:
-            case TokenType::PRINT:
-            case TokenType::RETURN:
-            return;
-            }
-            advance();
-        }
-    }
-};
-
+#ifndef parser_hpp
+#define parser_hpp
+#include "scanner.hpp"
+#include "arena.hpp"
+struct Expr;
+struct Binary;
+struct Assign;
+struct Unary;
+struct Grouping;
+struct Literal;
+struct Variable;
+struct Logical;
+struct Call;
+struct ExprVisitor;
+struct Stmt;
+struct Print;
+struct Var;
+struct Expression;
+struct Block;
+struct If;
+struct While;
+struct Function;
+struct Return;
+struct Increment;
+struct Store;
+struct PrintBinary;
+struct StmtVisitor;
+struct Environment;
+struct Chunk;
+class RuntimeError; 
+struct Diagnostic
+{
+    enum Kind { SCAN, PARSE, RUNTIME };
+    Kind kind;
+    int line;
+    std::string message;
+    bool atEnd = false;
+};
+typedef std::vector<Diagnostic> Diagnostics;
+class RuntimeError : public std::runtime_error 
+{
+    public:
+    int line;
+    RuntimeError(const Token* token, const std::string& message):
+    std::runtime_error(message), line(token->line){}
+    RuntimeError(int line, const std::string& message):
+    std::runtime_error(message), line(line){}
+};
+struct Binding
+{
+    enum { LOCAL = 0, GLOBAL = 1 };
+    uint32_t depth = GLOBAL;
+    uint32_t slot = 0;
+};
+struct Environment
+{
+    std::vector<Value> slots;
+};
+struct Expr
+{
+    virtual Value accept(ExprVisitor& visitor) = 0;
+};
+struct ExprVisitor 
+{
+    virtual ~ExprVisitor() = default;
+    virtual Value visitUnaryExpr(const Unary& expr) = 0;
+    virtual Value visitBinaryExpr(const Binary& expr) = 0;
+    virtual Value visitAssignExpr(const Assign& expr) = 0;
+    virtual Value visitLiteralExpr(const Literal& expr) = 0;
+    virtual Value visitGroupingExpr(const Grouping& expr) = 0;
+    virtual Value visitVariableExpr(const Variable& expr) = 0;
+    virtual Value visitLogicalExpr(const Logical& expr) = 0;
+    virtual Value visitCallExpr(const Call& expr) = 0;
+};
+typedef Value (*BinaryKernel)(const Value& left, const Value& right, const Token* op);
+struct kernels
+{
+    static void numbers(const Value& left, const Value& right, const Token* op)
+    {
+        if(!left.isNumber() || !right.isNumber())
+        throw RuntimeError(op, "Operands must be numbers.");
+    }
+    static Value add(const Value& left, const Value& right, const Token* op)
+    {
+        if(left.isNumber() && right.isNumber())
+        return left.as.number + right.as.number;
+        if(left.isString() && right.isString())
+        return concatenate(left, right);
+        throw RuntimeError(op, "Operands must be either strings or numbers.");
+    }
+    static Value sub(const Value& left, const Value& right, const Token* op)
+    {
+        if(left.isNumber() && right.isNumber())
+        return left.as.number - right.as.number;
+        numbers(left, right, op);
+        return Value();
+    }
+    static Value mul(const Value& left, const Value& right, const Token* op)
+    {
+        if(left.isNumber() && right.isNumber())
+        return left.as.number * right.as.number;
+        numbers(left, right, op);
+        return Value();
+    }
+    static Value div(const Value& left, const Value& right, const Token* op)
+    {
+        if(left.isNumber() && right.isNumber())
+        return left.as.number / right.as.number;
+        numbers(left, right, op);
+        return Value();
+    }
+    static Value greater(const Value& left, const Value& right, const Token* op)
+    {
+        if(left.isNumber() && right.isNumber())
+        return left.as.number > right.as.number;
+        numbers(left, right, op);
+        return Value();
+    }
+    static Value greaterEqual(const Value& left, const Value& right, const Token* op)
+    {
+        if(left.isNumber() && right.isNumber())
+        return left.as.number >= right.as.number;
+        numbers(left, right, op);
+        return Value();
+    }
+    static Value less(const Value& left, const Value& right, const Token* op)
+    {
+        if(left.isNumber() && right.isNumber())
+        return left.as.number < right.as.number;
+        numbers(left, right, op);
+        return Value();
+    }
+    static Value lessEqual(const Value& left, const Value& right, const Token* op)
+    {
+        if(left.isNumber() && right.isNumber())
+        return left.as.number <= right.as.number;
+        numbers(left, right, op);
+        return Value();
+    }
+    static Value equal(const Value& left, const Value& right, const Token*)
+    {
+        if(left.isNumber() && right.isNumber())
+        return left.as.number == right.as.number;
+        return isEqual(left, right);
+    }
+    static Value notEqual(const Value& left, const Value& right, const Token*)
+    {
+        if(left.isNumber() && right.isNumber())
+        return left.as.number != right.as.number;
+        return !isEqual(left, right);
+    }
+    static Value unexpected(const Value&, const Value&, const Token* op)
+    {
+        throw RuntimeError(op, "Unexpected binary operator.");
+    }
+    static BinaryKernel select(TokenType type)
+    {
+        switch(type)
+        {
+            case TokenType::ADD: return add;
+            case TokenType::SUB: return sub;
+            case TokenType::MUL: return mul;
+            case TokenType::DIV: return div;
+            case TokenType::GREATER: return greater;
+            case TokenType::GREATER_EQUAL: return greaterEqual;
+            case TokenType::LESS: return less;
+            case TokenType::LESS_EQUAL: return lessEqual;
+            case TokenType::EQUAL_EQUAL: return equal;
+            case TokenType::NOT_EQUAL: return notEqual;
+            default: return unexpected;
+        }
+    }
+};
+struct Binary : Expr
+{
+    Expr* left;
+    const Token* op;
+    Expr* right;
+    BinaryKernel kernel;
+    const Literal* leftLiteral;
+    const Literal* rightLiteral;
+    const Variable* leftVariable;
+    const Variable* rightVariable;
+    Binary(Expr* left, const Token* op, Expr* right):
+    left(left), op(op), right(right)
+    {
+        specialize();
+    }
+    void specialize();
+    bool pure() const
+    {
+        return rightLiteral != nullptr || rightVariable != nullptr;
+    }
+    bool simple() const
+    {
+        return pure() && (leftLiteral != nullptr || leftVariable != nullptr);
+    }
+    Value accept(ExprVisitor& visitor)
+    {
+        return visitor.visitBinaryExpr(*this);
+    }
+};
+struct Unary : Expr 
+{
+    const Token* op;
+    Expr* right;
+    Unary(const Token* op, Expr* right):
+    op(op), right(right){};
+    Value accept(ExprVisitor& visitor)
+    {
+        return visitor.visitUnaryExpr(*this);
+    }
+};
+struct Grouping : Expr 
+{
+    Expr* expression;
+    Grouping(Expr* expression):
+    expression(expression){}
+    Value accept(ExprVisitor& visitor)
+    {
+        return visitor.visitGroupingExpr(*this);
+    }
+};
+struct Literal : Expr 
+{
+    Value value;
+    Literal(Value value):
+    value(value){}
+    Value accept(ExprVisitor& visitor)
+    {
+        return visitor.visitLiteralExpr(*this);
+    }
+};
+struct Variable : Expr 
+{
+    const Token* token;
+    mutable Binding binding;
+    Variable(const Token* token):
+    token(token){}
+    Value accept(ExprVisitor& visitor)
+    {
+        return visitor.visitVariableExpr(*this);
+    }
+};
+struct Assign : Expr 
+{
+    const Token* token;
+    mutable Binding binding;
+    Expr* expression;
+    Assign(const Token* token, Expr* expression):
+    token(token), expression(expression){}
+    Value accept(ExprVisitor& visitor)
+    {
+        return visitor.visitAssignExpr(*this);
+    }
+};
+inline void Binary::specialize()
+{
+    kernel = kernels::select(op->type);
+    leftLiteral = dynamic_cast<const Literal*>(left);
+    rightLiteral = dynamic_cast<const Literal*>(right);
+    leftVariable = dynamic_cast<const Variable*>(left);
+    rightVariable = dynamic_cast<const Variable*>(right);
+}
+struct Logical : Expr
+{
+    Expr* left;
+    const Token* op;
+    Expr* right;
+    Logical(Expr* left, const Token* op, Expr* right):
+    left(left), op(op), right(right){}
+    Value accept(ExprVisitor& visitor)
+    {
+        return visitor.visitLogicalExpr(*this);
+    }
+};
+struct Call : Expr
+{
+    Expr* callee;
+    const Token* paren;
+    Expr** arguments;
+    uint32_t count;
+    Call(Expr* callee, const Token* paren, Expr** arguments, uint32_t count):
+    callee(callee), paren(paren), arguments(arguments), count(count){}
+    Value accept(ExprVisitor& visitor)
+    {
+        return visitor.visitCallExpr(*this);
+    }
+};
+
+struct Stmt
+{
+    int line = 0;
+    virtual void accept(StmtVisitor& visitor) = 0;
+};
+struct StmtVisitor
+{
+    virtual ~StmtVisitor() = default;
+    virtual void visitExpressionStmt(const Expression& stmt) = 0;
+    virtual void visitPrintStmt(const Print& stmt) = 0;
+    virtual void visitVarStmt(const Var& stmt) = 0;
+    virtual void visitBlockStmt(const Block& stmt) = 0;
+    virtual void visitIfStmt(const If& stmt) = 0;
+    virtual void visitWhileStmt(const While& stmt) = 0;
+    virtual void visitFunctionStmt(const Function& stmt) = 0;
+    virtual void visitReturnStmt(const Return& stmt) = 0;
+    virtual void visitIncrementStmt(const Increment& stmt) = 0;
+    virtual void visitStoreStmt(const Store& stmt) = 0;
+    virtual void visitPrintBinaryStmt(const PrintBinary& stmt) = 0;
+};
+struct Expression : Stmt 
+{
+    Expr* expression;
+    Expression(Expr* expression):
+    expression(expression){}
+    void accept(StmtVisitor& visitor)
+    {
+        visitor.visitExpressionStmt(*this);
+    }
+};
+struct Print : Stmt
+{
+    Expr* printExpression;
+    Print(Expr* printExpression):
+    printExpression(printExpression){}
+    void accept(StmtVisitor& visitor)
+    {
+        visitor.visitPrintStmt(*this);
+    }
+};
+struct Var : Stmt 
+{
+    const Token* token;
+    mutable Binding binding;
+    Expr* expression;
+    Var(const Token* token, Expr* expression):
+    token(token), expression(expression){}
+    void accept(StmtVisitor& visitor)
+    {
+        visitor.visitVarStmt(*this);
+    }
+};
+struct Block : Stmt
+{
+    Stmt** statements;
+    uint32_t count;
+    Block(Stmt** statements, uint32_t count):
+    statements(statements), count(count){}
+    void accept(StmtVisitor& visitor)
+    {
+        visitor.visitBlockStmt(*this);
+    }
+};
+struct If : Stmt
+{
+    Expr* condition;
+    Stmt* thenBranch;
+    Stmt* elseBranch;
+    If(Expr* condition, Stmt* thenBranch, Stmt* elseBranch):
+    condition(condition), thenBranch(thenBranch), elseBranch(elseBranch){}
+    void accept(StmtVisitor& visitor)
+    {
+        visitor.visitIfStmt(*this);
+    }
+};
+struct While : Stmt
+{
+    Expr* condition;
+    Stmt* body;
+    While(Expr* condition, Stmt* body):
+    condition(condition), body(body){}
+    void accept(StmtVisitor& visitor)
+    {
+        visitor.visitWhileStmt(*this);
+    }
+};
+struct Function : Stmt
+{
+    const Token* name;
+    const Token* params;
+    uint32_t arity;
+    Stmt** body;
+    uint32_t count;
+    mutable Binding binding;
+    mutable uint32_t slots = 0;
+    mutable const Chunk* chunk = nullptr;
+    mutable uint32_t entry = 0;
+    mutable int maxStack = 0;
+    Function(const Token* name, const Token* params, uint32_t arity, Stmt** body, uint32_t count):
+    name(name), params(params), arity(arity), body(body), count(count){}
+    void accept(StmtVisitor& visitor)
+    {
+        visitor.visitFunctionStmt(*this);
+    }
+};
+inline std::string functionName(const Function* function)
+{
+    return std::string(function->name->lexeme);
+}
+inline std::string stringify(const Value& value)
+{
+    switch(value.type)
+    {
+        case ValueType::NIL:
+        return "nil";
+        case ValueType::NUMBER:
+        {
+            char buffer[32];
+            return std::string(buffer, formatNumber(buffer, value.asNumber()));
+        }
+        case ValueType::BOOL:
+        {
+            if(value.asBool() == true)
+            return "true";
+            return "false";
+        }
+        case ValueType::STRING:
+        return value.asString();
+        case ValueType::FUNCTION:
+        return "<fn " + functionName(value.asFunction()) + ">";
+    }
+    return "????";
+}
+struct Return : Stmt
+{
+    const Token* keyword;
+    Expr* value;
+    Return(const Token* keyword, Expr* value):
+    keyword(keyword), value(value){}
+    void accept(StmtVisitor& visitor)
+    {
+        visitor.visitReturnStmt(*this);
+    }
+};
+struct Increment : Stmt
+{
+    const Binding* target;
+    const Binary* update;
+    double delta;
+    Stmt* original;
+    Increment(const Binding* target, const Binary* update, double delta, Stmt* original):
+    target(target), update(update), delta(delta), original(original){}
+    void accept(StmtVisitor& visitor)
+    {
+        visitor.visitIncrementStmt(*this);
+    }
+};
+struct Store : Stmt
+{
+    const Binding* target;
+    const Binary* value;
+    Stmt* original;
+    Store(const Binding* target, const Binary* value, Stmt* original):
+    target(target), value(value), original(original){}
+    void accept(StmtVisitor& visitor)
+    {
+        visitor.visitStoreStmt(*this);
+    }
+};
+struct PrintBinary : Stmt
+{
+    const Binary* value;
+    Stmt* original;
+    PrintBinary(const Binary* value, Stmt* original):
+    value(value), original(original){}
+    void accept(StmtVisitor& visitor)
+    {
+        visitor.visitPrintBinaryStmt(*this);
+    }
+};
+
+struct parser
+{
+    scanner& source;
+    Arena& arena;
+    Diagnostics& diagnostics;
+    int nesting = 0;
+    bool panicking = false;
+    size_t consumed = 0;
+    std::vector<Token*>* identifiers = nullptr;
+    Token previousToken;
+    Token currentToken;
+    parser(scanner& source, Arena& arena, Diagnostics& diagnostics):
+    source(source), arena(arena), diagnostics(diagnostics), currentToken(next()){}
+    std::vector<Stmt*> parse() 
+    {
+        std::vector<Stmt*> statements;
+        while(!isAtEnd())
+        {
+            Stmt* statement = declaration();
+            if(statement != nullptr)
+            statements.push_back(statement);
+        }    
+        return statements;
+    }
+    Stmt* declaration()
+    {
+        int line = peek()->line;
+        size_t before = consumed;
+        Stmt* statement;
+        if(match(TokenType::FUN) == true)
+        statement = located(line, funDeclaration());
+        else if(match(TokenType::VAR) == true)
+        statement = located(line, varDeclaration());
+        else
+        statement = this->statement();
+        if(panicking == true)
+        {
+            synchronize(before);
+            return nullptr;
+        }
+        return statement;
+    }
+    Stmt* varDeclaration()
+    {
+        const Token* name = hold(consume(TokenType::IDENTIFIER, "Expected variable name."));
+        Expr* initializer = nullptr;
+        if(match(TokenType::EQUAL) == true)
+        {
+            initializer = expression();
+        }
+        consume(TokenType::SEMICOLON, "Expected a ';' after end of variable statement.");
+        return arena.make<Var>(name, initializer);
+    }
+    Stmt* funDeclaration()
+    {
+        if(nesting > 0)
+        error(previous(), "Functions can only be declared at top level.");
+        const Token* name = hold(consume(TokenType::IDENTIFIER, "Expected function name."));
+        consume(TokenType::LEFT_PAREN, "Expected '(' after function name.");
+        std::vector<Token> params;
+        if(!check(TokenType::RIGHT_PAREN))
+        {
+            do
+            {
+                if(params.size() >= 255)
+                error(peek(), "Can't have more than 255 parameters.");
+                params.push_back(*consume(TokenType::IDENTIFIER, "Expected parameter name."));
+            }
+            while(match(TokenType::COMMA));
+        }
+        consume(TokenType::RIGHT_PAREN, "Expected ')' after parameters.");
+        consume(TokenType::LEFT_BRACE, "Expected '{' before function body.");
+        std::vector<Stmt*> body = block();
+        Token* held = arena.array(params);
+        if(identifiers != nullptr)
+        {
+            for(size_t i = 0; i < params.size(); i++)
+            identifiers->push_back(&held[i]);
+        }
+        return arena.make<Function>(name, held, params.size(), arena.array(body), body.size());
+    }
+    Stmt* located(int line, Stmt* statement)
+    {
+        statement->line = line;
+        return statement;
+    }
+    Stmt* statement()
+    {
+        int line = peek()->line;
+        if(match(TokenType::FOR) == true)
+        return forStatement(line);
+        if(match(TokenType::IF) == true)
+        return located(line, ifStatement());
+        if(match(TokenType::PRINT) == true)
+        return located(line, printStatement());
+        if(match(TokenType::RETURN) == true)
+        return located(line, returnStatement());
+        if(match(TokenType::WHILE) == true)
+        return located(line, whileStatement());
+        if(match(TokenType::LEFT_BRACE) == true)
+        return located(line, makeBlock(block()));
+        return located(line, expressionStatement());
+    }
+    std::vector<Stmt*> block()
+    {
+        std::vector<Stmt*> statements;
+        nesting++;
+        while(!check(TokenType::RIGHT_BRACE) && !isAtEnd())
+        {
+            Stmt* statement = declaration();
+            if(statement != nullptr)
+            statements.push_back(statement);
+        }
+        nesting--;
+        consume(TokenType::RIGHT_BRACE, "Expected '}' after block.");
+        return statements;
+    }
+    Stmt* makeBlock(const std::vector<Stmt*>& statements)
+    {
+        return arena.make<Block>(arena.array(statements), statements.size());
+    }
+    Stmt* ifStatement()
+    {
+        consume(TokenType::LEFT_PAREN, "Expected '(' after 'if'.");
+        Expr* condition = expression();
+        consume(TokenType::RIGHT_PAREN, "Expected ')' after if condition.");
+        Stmt* thenBranch = statement();
+        Stmt* elseBranch = nullptr;
+        if(match(TokenType::ELSE) == true)
+        elseBranch = statement();
+        return arena.make<If>(condition, thenBranch, elseBranch);
+    }
+    Stmt* whileStatement()
+    {
+        consume(TokenType::LEFT_PAREN, "Expected '(' after 'while'.");
+        Expr* condition = expression();
+        consume(TokenType::RIGHT_PAREN, "Expected ')' after condition.");
+        Stmt* body = statement();
+        return arena.make<While>(condition, body);
+    }
+    Stmt* forStatement(int line)
+    {
+        consume(TokenType::LEFT_PAREN, "Expected '(' after 'for'.");
+        Stmt* initializer = nullptr;
+        if(match(TokenType::SEMICOLON) == true)
+        initializer = nullptr;
+        else if(match(TokenType::VAR) == true)
+        initializer = located(line, varDeclaration());
+        else
+        initializer = located(line, expressionStatement());
+        Expr* condition = nullptr;
+        if(!check(TokenType::SEMICOLON))
+        condition = expression();
+        consume(TokenType::SEMICOLON, "Expected ';' after loop condition.");
+        Expr* increment = nullptr;
+        if(!check(TokenType::RIGHT_PAREN))
+        increment = expression();
+        consume(TokenType::RIGHT_PAREN, "Expected ')' after for clauses.");
+        Stmt* body = statement();
+        if(increment != nullptr)
+        body = located(line, makeBlock({body, located(line, arena.make<Expression>(increment))}));
+        if(condition == nullptr)
+        condition = arena.make<Literal>(true);
+        body = located(line, arena.make<While>(condition, body));
+        if(initializer != nullptr)
+        body = located(line, makeBlock({initializer, body}));
+        return body;
+    }
+    Stmt* returnStatement()
+    {
+        const Token* keyword = hold(previous());
+        Expr* value = nullptr;
+        if(!check(TokenType::SEMICOLON))
+        value = expression();
+        consume(TokenType::SEMICOLON, "Expected ';' after return value.");
+        return arena.make<Return>(keyword, value);
+    }
+    Stmt* printStatement()
+    {
+        Expr* pexpression = expression();
+        consume(TokenType::SEMICOLON, "Expected a semicolon after print statement.");
+        return arena.make<Print>(pexpression);
+    }
+    Stmt* expressionStatement()
+    {
+        Expr* eexpression = expression();
+        consume(TokenType::SEMICOLON, "Expected a semicolon after expression statement.");
+        return arena.make<Expression>(eexpression);
+    }
+    Expr* expression()
+    {
+        return assignment();
+    }
+    Expr* assignment()
+    {
+        Expr* expression = logicalOr();
+        {
+            if(match(TokenType::EQUAL) == true)
+            {
+                Token equals = *previous();
+                Expr* value = assignment();
+                Variable* varExpr = dynamic_cast<Variable*>(expression);
+                if(varExpr != nullptr)
+                {
+                    const Token* name = varExpr->token;
+                    return arena.make<Assign>(name, value);
+                }
+                error(&equals, "Invalid Assignment Target.");
+            }
+        }
+        return expression;
+    }
+    Expr* logicalOr()
+    {
+        Expr* left = logicalAnd();
+        while(match(TokenType::OR))
+        {
+            const Token* op = hold(previous());
+            Expr* right = logicalAnd();
+            left = arena.make<Logical>(left, op, right);
+        }
+        return left;
+    }
+    Expr* logicalAnd()
+    {
+        Expr* left = equality();
+        while(match(TokenType::AND))
+        {
+            const Token* op = hold(previous());
+            Expr* right = equality();
+            left = arena.make<Logical>(left, op, right);
+        }
+        return left;
+    }
+    Expr* equality()
+    {
+        Expr* left = comparison();
+        while((match(TokenType::NOT_EQUAL)) || (match(TokenType::EQUAL_EQUAL)))
+        {
+            const Token* op = hold(previous());
+            Expr* right = comparison();
+            left = arena.make<Binary>(left, op, right);
+        }
+        return left;
+    }
+    Expr* comparison()
+    {
+        Expr* left = term();
+        while(match(TokenType::GREATER_EQUAL) || match(TokenType::GREATER) || match(TokenType::LESS_EQUAL) || match(TokenType::LESS))
+        {
+            const Token* op = hold(previous());
+            Expr* right = term();
+            left = arena.make<Binary>(left, op, right);
+        }
+        return left;
+    }
+    Expr* term()
+    {
+        Expr* left = factor();
+        while(match(TokenType::ADD) || match(TokenType::SUB))
+        {
+            const Token* op = hold(previous());
+            Expr* right = factor();
+            left = arena.make<Binary>(left, op, right);
+        }
+        return left;
+    }
+    Expr* factor()
+    {
+        Expr* left = unary();
+        while(match(TokenType::MUL) || match(TokenType::DIV))
+        {
+            const Token* op = hold(previous());
+            Expr* right = unary();
+            left = arena.make<Binary>(left, op, right);
+        }
+        return left;
+    }
+    Expr* unary()
+    {
+        if(match(TokenType::SUB) || match(TokenType::NOT))
+        {
+            const Token* op = hold(previous());
+            Expr* right = unary();
+            return arena.make<Unary>(op, right);
+        }
+        return call();
+    }
+    Expr* call()
+    {
+        Expr* callee = primary();
+        while(match(TokenType::LEFT_PAREN))
+        {
+            callee = finishCall(callee);
+        }
+        return callee;
+    }
+    Expr* finishCall(Expr* callee)
+    {
+        std::vector<Expr*> arguments;
+        if(!check(TokenType::RIGHT_PAREN))
+        {
+            do
+            {
+                if(arguments.size() >= 255)
+                error(peek(), "Can't have more than 255 arguments.");
+                arguments.push_back(expression());
+            }
+            while(match(TokenType::COMMA));
+        }
+        const Token* paren = hold(consume(TokenType::RIGHT_PAREN, "Expected ')' after arguments."));
+        return arena.make<Call>(callee, paren, arena.array(arguments), arguments.size());
+    }
+    Expr* primary()
+    {
+        if(match(TokenType::FALSE)) return arena.make<Literal>(false);
+        if(match(TokenType::TRUE)) return arena.make<Literal>(true);
+        if(match(TokenType::NIL)) return arena.make<Literal>(nullptr);
+        if(match(TokenType::NUMBER)) return arena.make<Literal>(previous()->number);
+        if(match(TokenType::STRING))
+        {
+            std::string_view lexeme = previous()->lexeme;
+            StringObject* text = arena.create<StringObject>(std::string(lexeme.substr(1, lexeme.size() - 2)));
+            return arena.make<Literal>(Value::constant(text));
+        }
+        if (match(LEFT_PAREN)) 
+        {
+            Expr* gexpression = expression();
+            consume(TokenType::RIGHT_PAREN, "Expect ')' after expression.");
+            return arena.make<Grouping>(gexpression);
+        }
+        if(match(TokenType::IDENTIFIER)) return arena.make<Variable>(hold(previous()));
+        fail(peek(), "Expected an Expression.");
+        return arena.make<Literal>(nullptr);
+    }
+
+    const Token* hold(const Token* token)
+    {
+        Token* copy = arena.copy(*token);
+        if(identifiers != nullptr && copy->type == TokenType::IDENTIFIER)
+        identifiers->push_back(copy);
+        return copy;
+    }
+
+    void error(const Token* token, std::string_view message)
+    {
+        if(panicking == true)
+        return;
+        diagnostics.push_back(Diagnostic{Diagnostic::PARSE, token->line, std::string(message), token->type == TokenType::EOF_TOKEN});
+    }
+
+    void fail(const Token* token, std::string_view message)
+    {
+        error(token, message);
+        panicking = true;
+    }
+
+    const Token* consume(TokenType type, std::string_view message)
+    {
+        if(check(type)) return advance();
+        fail(peek(), message);
+        return peek();
+    }
+
+    bool match(TokenType type)
+    {
+        if(check(type) == true)
+        {
+            advance();
+            return true;
+        }
+        return false;
+    }
+
+    bool check(TokenType type)
+    {
+        if(isAtEnd() == true)
+        return false;
+        if(peek()->type != type)
+        return false;
+        return true;
+    }
+
+    const Token* advance()
+    {
+        if(!isAtEnd())
+        {
+            previousToken = currentToken;
+            currentToken = next();
+            consumed++;
+        }
+        return previous();
+    }
+
+    Token next()
+    {
+        Token token = source.next();
+        while(token.type == TokenType::ERROR_TOKEN)
+        {
+            if(panicking == false)
+            diagnostics.push_back(Diagnostic{Diagnostic::SCAN, token.line, std::string(token.lexeme) + " at line " + std::to_string(token.line)});
+            panicking = true;
+            token = source.next();
+        }
+        return token;
+    }
+
+    bool isAtEnd()
+    {
+        if(peek()->type == TokenType::EOF_TOKEN)
+        {
+            return true;
+        }
+        return false;
+    }
+
+    const Token* peek()
+    {
+        return &currentToken;
+    }
+
+    const Token* previous()
+    {
+        return &previousToken;
+    }
+    void synchronize(size_t before) 
+    {
+        panicking = false;
+        if(consumed == before)
+        {
+            if(nesting > 0 && check(TokenType::RIGHT_BRACE))
+            return;
+            advance();
+        }
+        while (!isAtEnd()) 
+        {
+            if (previous()->type == TokenType::SEMICOLON) 
+            return;
+            if(nesting > 0 && check(TokenType::RIGHT_BRACE))
+            return;
+            switch (peek()->type) 
+            {
+            case TokenType::FUN:
+            case TokenType::VAR:
+            case TokenType::FOR:
+            case TokenType::IF:
+            case TokenType::WHILE:
+            case TokenType::PRINT:
+            case TokenType::RETURN:
+            return;
+            default:
+            break;
+            }
+            advance();
+        }
+    }
+};
+
 #endif
\ No newline at end of file
@@ -0,0 +1,182 @@
+#ifndef profiler_hpp
+#define profiler_hpp
+#include <map>
+#include <chrono>
+#include <cstdlib>
+#include <csignal>
+#include <fstream>
+#include <iomanip>
+#include <typeindex>
+#include <algorithm>
+#include <sys/time.h>
+#include "parser.hpp"
+#if defined(__GNUC__)
+#include <cxxabi.h>
+#define PROFILER_COLD __attribute__((noinline, cold))
+#else
+#define PROFILER_COLD
+#endif
+
+struct ProfileEntry
+{
+    uint64_t count = 0;
+    uint64_t nanos = 0;
+};
+
+struct profiler
+{
+    static constexpr int SAMPLE_MICROS = 1000;
+    static inline volatile std::sig_atomic_t tick = 0;
+    struct Frame
+    {
+        int path;
+        uint64_t start;
+        uint64_t children;
+    };
+    bool sampling = false;
+    std::vector<ProfileEntry> lines;
+    std::unordered_map<std::type_index, ProfileEntry> kinds;
+    std::vector<std::string> paths{"main"};
+    std::vector<ProfileEntry> stacks{ProfileEntry()};
+    std::map<std::pair<int, const Function*>, int> callees;
+    std::vector<Frame> frames;
+    int line = 0;
+    uint64_t nodeChildren = 0;
+    uint64_t lineChildren = 0;
+    uint64_t samples = 0;
+    static uint64_t now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    void start()
+    {
+        frames.push_back(Frame{0, now(), 0});
+        if(sampling == false)
+        return;
+        std::signal(SIGPROF, [](int){ tick = 1; });
+        itimerval timer{{0, SAMPLE_MICROS}, {0, SAMPLE_MICROS}};
+        setitimer(ITIMER_PROF, &timer, nullptr);
+    }
+    void stop()
+    {
+        if(sampling == true)
+        {
+            itimerval timer{};
+            setitimer(ITIMER_PROF, &timer, nullptr);
+            std::signal(SIGPROF, SIG_DFL);
+        }
+        while(!frames.empty())
+        leave();
+    }
+    ProfileEntry& lineEntry(int line)
+    {
+        if((size_t)line >= lines.size())
+        lines.resize(line + 1);
+        return lines[line];
+    }
+    void sample()
+    {
+        tick = 0;
+        samples++;
+        lineEntry(line).count++;
+        stacks[frames.back().path].count++;
+    }
+    void record(const std::type_info& kind, uint64_t elapsed, uint64_t children)
+    {
+        ProfileEntry& entry = kinds[std::type_index(kind)];
+        entry.count++;
+        entry.nanos += elapsed - children;
+    }
+    void recordLine(int line, uint64_t elapsed, uint64_t children)
+    {
+        ProfileEntry& entry = lineEntry(line);
+        entry.count++;
+        entry.nanos += elapsed - children;
+    }
+    void enter(const Function* function)
+    {
+        int parent = frames.back().path;
+        auto found = callees.find({parent, function});
+        int path;
+        if(found == callees.end())
+        {
+            path = paths.size();
+            paths.push_back(paths[parent] + ";" + functionName(function));
+            stacks.emplace_back();
+            callees.emplace(std::make_pair(parent, function), path);
+        }
+        else
+        path = found->second;
+        frames.push_back(Frame{path, sampling ? 0 : now(), 0});
+    }
+    void leave()
+    {
+        Frame frame = frames.back();
+        frames.pop_back();
+        if(sampling == true)
+        return;
+        uint64_t elapsed = now() - frame.start;
+        stacks[frame.path].count++;
+        stacks[frame.path].nanos += elapsed - frame.children;
+        if(!frames.empty())
+        frames.back().children += elapsed;
+    }
+    static std::string kindName(const std::type_index& kind)
+    {
+        #if defined(__GNUC__)
+        int status = 0;
+        char* demangled = abi::__cxa_demangle(kind.name(), nullptr, nullptr, &status);
+        if(demangled != nullptr)
+        {
+            std::string name(demangled);
+            std::free(demangled);
+            return name;
+        }
+        #endif
+        return kind.name();
+    }
+    void report(std::ostream& out, size_t top) const
+    {
+        std::vector<std::pair<int, ProfileEntry>> hot;
+        for(size_t i = 0; i < lines.size(); i++)
+        {
+            if(lines[i].count > 0)
+            hot.emplace_back(i, lines[i]);
+        }
+        out << std::fixed << std::setprecision(3);
+        if(sampling == true)
+        {
+            std::sort(hot.begin(), hot.end(), [](const auto& a, const auto& b){ return a.second.count > b.second.count; });
+            out << "profile : " << samples << " samples every " << SAMPLE_MICROS << " us" << std::endl;
+            out << std::setw(8) << "line" << std::setw(12) << "samples" << std::setw(10) << "share" << std::endl;
+            for(size_t i = 0; i < hot.size() && i < top; i++)
+            out << std::setw(8) << hot[i].first << std::setw(12) << hot[i].second.count << std::setw(9) << 100.0 * hot[i].second.count / std::max<uint64_t>(samples, 1) << "%" << std::endl;
+            return;
+        }
+        std::sort(hot.begin(), hot.end(), [](const auto& a, const auto& b){ return a.second.nanos > b.second.nanos; });
+        out << std::setw(8) << "line" << std::setw(12) << "count" << std::setw(14) << "self ms" << std::endl;
+        for(size_t i = 0; i < hot.size() && i < top; i++)
+        out << std::setw(8) << hot[i].first << std::setw(12) << hot[i].second.count << std::setw(14) << hot[i].second.nanos / 1e6 << std::endl;
+        std::vector<std::pair<std::string, ProfileEntry>> nodes;
+        for(const auto& kind : kinds)
+        nodes.emplace_back(kindName(kind.first), kind.second);
+        std::sort(nodes.begin(), nodes.end(), [](const auto& a, const auto& b){ return a.second.nanos > b.second.nanos; });
+        out << std::setw(12) << "node" << std::setw(12) << "count" << std::setw(14) << "self ms" << std::endl;
+        for(size_t i = 0; i < nodes.size() && i < top; i++)
+        out << std::setw(12) << nodes[i].first << std::setw(12) << nodes[i].second.count << std::setw(14) << nodes[i].second.nanos / 1e6 << std::endl;
+    }
+    bool write_folded(const std::string& path) const
+    {
+        std::ofstream file(path);
+        if(!file)
+        return false;
+        for(size_t i = 0; i < paths.size(); i++)
+        {
+            uint64_t weight = sampling ? stacks[i].count : stacks[i].nanos / 1000;
+            if(weight > 0)
+            file << paths[i] << " " << weight << "\n";
+        }
+        return true;
+    }
+};
+#endif
@@ -0,0 +1,255 @@
+#ifndef resolver_hpp
+#define resolver_hpp
+#include "parser.hpp"
+
+struct resolver : public ExprVisitor, public StmtVisitor
+{
+    struct Local
+    {
+        uint32_t symbol;
+        uint32_t slot;
+    };
+    std::vector<int32_t> globalSlots;
+    std::vector<bool> defined;
+    uint32_t globalCount = 0;
+    std::vector<Local> locals;
+    std::vector<size_t> scopes;
+    uint32_t frameSize = 0;
+    uint32_t scriptSlots = 0;
+    const Function* function = nullptr;
+    std::vector<const Token*> pending;
+    Diagnostics* diagnostics = nullptr;
+    struct Mark
+    {
+        uint32_t globalCount;
+        std::vector<bool> defined;
+    };
+    void resolve(Stmt* statement, Diagnostics& diagnostics)
+    {
+        this->diagnostics = &diagnostics;
+        statement->accept(*this);
+    }
+    void resolve(Expr* expr)
+    {
+        expr->accept(*this);
+    }
+    void finish(Diagnostics& diagnostics)
+    {
+        for(const Token* name : pending)
+        {
+            if(defined[globalSlots[name->symbol]] == false)
+            diagnostics.push_back(Diagnostic{Diagnostic::PARSE, name->line, "Undefined variable '" + std::string(name->lexeme) + "'."});
+        }
+        pending.clear();
+    }
+    Mark mark() const
+    {
+        return Mark{globalCount, defined};
+    }
+    void rollback(const Mark& mark)
+    {
+        for(int32_t& slot : globalSlots)
+        {
+            if(slot >= (int32_t)mark.globalCount)
+            slot = -1;
+        }
+        globalCount = mark.globalCount;
+        defined = mark.defined;
+        pending.clear();
+    }
+    uint32_t declare(uint32_t symbol)
+    {
+        uint32_t slot = reserve(symbol);
+        defined[slot] = true;
+        return slot;
+    }
+    uint32_t reserve(uint32_t symbol)
+    {
+        if(symbol >= globalSlots.size())
+        globalSlots.resize(symbol + 1, -1);
+        if(globalSlots[symbol] < 0)
+        {
+            globalSlots[symbol] = globalCount++;
+            defined.push_back(false);
+        }
+        return globalSlots[symbol];
+    }
+    int32_t find(uint32_t symbol) const
+    {
+        if(symbol < globalSlots.size() && globalSlots[symbol] >= 0 && defined[globalSlots[symbol]] == true)
+        return globalSlots[symbol];
+        return -1;
+    }
+    void beginScope()
+    {
+        scopes.push_back(locals.size());
+    }
+    void endScope()
+    {
+        locals.resize(scopes.back());
+        scopes.pop_back();
+    }
+    uint32_t declareLocal(const Token* name)
+    {
+        for(size_t i = scopes.back(); i < locals.size(); i++)
+        {
+            if(locals[i].symbol == name->symbol)
+            diagnostics->push_back(Diagnostic{Diagnostic::PARSE, name->line, "Already a variable named '" + std::string(name->lexeme) + "' in this scope."});
+        }
+        uint32_t slot = locals.size();
+        locals.push_back(Local{name->symbol, slot});
+        if(locals.size() > frameSize)
+        frameSize = locals.size();
+        return slot;
+    }
+    void lookup(const Token* name, Binding& binding)
+    {
+        for(size_t i = locals.size(); i > 0; i--)
+        {
+            if(locals[i - 1].symbol == name->symbol)
+            {
+                binding.depth = Binding::LOCAL;
+                binding.slot = locals[i - 1].slot;
+                return;
+            }
+        }
+        binding.depth = Binding::GLOBAL;
+        int32_t slot = find(name->symbol);
+        if(slot >= 0)
+        {
+            binding.slot = slot;
+            return;
+        }
+        if(function != nullptr)
+        {
+            binding.slot = reserve(name->symbol);
+            pending.push_back(name);
+            return;
+        }
+        diagnostics->push_back(Diagnostic{Diagnostic::PARSE, name->line, "Undefined variable '" + std::string(name->lexeme) + "'."});
+    }
+    Value visitBinaryExpr(const Binary& expr)
+    {
+        resolve(expr.left);
+        resolve(expr.right);
+        return Value();
+    }
+    Value visitUnaryExpr(const Unary& expr)
+    {
+        resolve(expr.right);
+        return Value();
+    }
+    Value visitLiteralExpr(const Literal&)
+    {
+        return Value();
+    }
+    Value visitGroupingExpr(const Grouping& expr)
+    {
+        resolve(expr.expression);
+        return Value();
+    }
+    Value visitVariableExpr(const Variable& expr)
+    {
+        lookup(expr.token, expr.binding);
+        return Value();
+    }
+    Value visitAssignExpr(const Assign& expr)
+    {
+        resolve(expr.expression);
+        lookup(expr.token, expr.binding);
+        return Value();
+    }
+    Value visitLogicalExpr(const Logical& expr)
+    {
+        resolve(expr.left);
+        resolve(expr.right);
+        return Value();
+    }
+    Value visitCallExpr(const Call& expr)
+    {
+        resolve(expr.callee);
+        for(uint32_t i = 0; i < expr.count; i++)
+        resolve(expr.arguments[i]);
+        return Value();
+    }
+    void visitExpressionStmt(const Expression& stmt)
+    {
+        resolve(stmt.expression);
+    }
+    void visitPrintStmt(const Print& stmt)
+    {
+        resolve(stmt.printExpression);
+    }
+    void visitVarStmt(const Var& stmt)
+    {
+        if(stmt.expression != nullptr)
+        resolve(stmt.expression);
+        if(scopes.empty())
+        {
+            stmt.binding.depth = Binding::GLOBAL;
+            stmt.binding.slot = declare(stmt.token->symbol);
+            return;
+        }
+        stmt.binding.depth = Binding::LOCAL;
+        stmt.binding.slot = declareLocal(stmt.token);
+    }
+    void visitBlockStmt(const Block& stmt)
+    {
+        beginScope();
+        for(uint32_t i = 0; i < stmt.count; i++)
+        stmt.statements[i]->accept(*this);
+        endScope();
+        if(function == nullptr && frameSize > scriptSlots)
+        scriptSlots = frameSize;
+    }
+    void visitIfStmt(const If& stmt)
+    {
+        resolve(stmt.condition);
+        stmt.thenBranch->accept(*this);
+        if(stmt.elseBranch != nullptr)
+        stmt.elseBranch->accept(*this);
+    }
+    void visitWhileStmt(const While& stmt)
+    {
+        resolve(stmt.condition);
+        stmt.body->accept(*this);
+    }
+    void visitFunctionStmt(const Function& stmt)
+    {
+        stmt.binding.depth = Binding::GLOBAL;
+        stmt.binding.slot = declare(stmt.name->symbol);
+        uint32_t scriptFrame = frameSize;
+        const Function* enclosing = function;
+        function = &stmt;
+        frameSize = 0;
+        beginScope();
+        for(uint32_t i = 0; i < stmt.arity; i++)
+        declareLocal(&stmt.params[i]);
+        for(uint32_t i = 0; i < stmt.count; i++)
+        stmt.body[i]->accept(*this);
+        endScope();
+        stmt.slots = frameSize;
+        frameSize = scriptFrame;
+        function = enclosing;
+    }
+    void visitReturnStmt(const Return& stmt)
+    {
+        if(function == nullptr)
+        diagnostics->push_back(Diagnostic{Diagnostic::PARSE, stmt.keyword->line, "Can't return from top-level code."});
+        if(stmt.value != nullptr)
+        resolve(stmt.value);
+    }
+    void visitIncrementStmt(const Increment& stmt)
+    {
+        stmt.original->accept(*this);
+    }
+    void visitStoreStmt(const Store& stmt)
+    {
+        stmt.original->accept(*this);
+    }
+    void visitPrintBinaryStmt(const PrintBinary& stmt)
+    {
+        stmt.original->accept(*this);
+    }
+};
+#endif
@@ -1,199 +1,414 @@
-#ifndef scanner_hpp
-#define scanner_hpp
-#include <any>
-#include <string>
-#include <vector>
-#include <cctype>
-#include <memory>
-#include <iostream>
-#include <stdexcept>
-#include <unordered_map>
-
-enum TokenType
-{
-    LEFT_PAREN, RIGHT_PAREN,
-    LEFT_BRACE, RIGHT_BRACE,
-    COMMA, DOT, SUB, ADD, SEMICOLON, DIV, MUL,
-    NOT,  NOT_EQUAL,
-    EQUAL, EQUAL_EQUAL,
-    GREATER, GREATER_EQUAL,
-    LESS, LESS_EQUAL,
-    IDENTIFIER, STRING, NUMBER,
-    AND, CLASS, ELSE, FALSE, FUN, FOR, IF, NIL, OR,
-    PRINT, RETURN, SUPER, THIS, TRUE, VAR, WHILE,
-    EOF_TOKEN
-};
-
-struct Token
-{
-    std::string lexeme;
-    std::any literal;
-    TokenType type;
-    int line;
-    Token(std::string lexeme, std::any literal, TokenType type, int line):
-    lexeme(lexeme), literal(literal), type(type), line(line){}
-};
-
-class scanner
-{
-    public:
-    scanner(const std::string& source):
-    source(source){}
-    int start = 0;
-    int current = 0;
-    int line = 1;
-    const std::string& source;
-    std::vector<std::shared_ptr<Token>> tokens;
-    static std::unordered_map<std::string, TokenType> keywords;
-    std::vector<std::shared_ptr<Token>> scan_tokens()
-    {
-        while(!isAtEnd())
-        {
-            start = current;
-            scan_token();
-        }
-        tokens.emplace_back(std::make_shared<Token>("", std::any{}, TokenType::EOF_TOKEN, line));
-        return tokens;
-    }
-    bool isAtEnd()
-    {
-        if(current >= source.size())
-        return true;
-        return false;
-    }
-    void add_token(TokenType type, std::any literal = std::any{})
-    {
-        std::string text = source.substr(start, current - start);
-        tokens.emplace_back(std::make_shared<Token>(text, literal, type, line));
-    }
-    bool match(char expected)
-    {
-        if(isAtEnd() == true)
-        return false;
-        if(source[current] != expected)
-        return false;
-        current++;
-        return true;
-    }
-    char peek()
-    {
-        if(isAtEnd() == true)
-        return '\0';
-        else
-        return source[current];
-    }
-    char peek_next()
-    {
-        if(current + 1 >= source.size())
-        return '\0';
-        return source[current + 1];
-    }
-    char advance()
-    {
-        if(isAtEnd())
-        return '\0';
-        char curr = source[current];
-        current++;
-        return curr;
-    }
-    void scan_token()
-    {
-        char ch = advance();
-        switch(ch)
-        {
-            case '(': add_token(TokenType::LEFT_PAREN); break;
-            case '{': add_token(TokenType::LEFT_BRACE); break;
-            case ')': add_token(TokenType::RIGHT_PAREN); break;
-            case '}': add_token(TokenType::RIGHT_BRACE); break;
-            case ',': add_token(TokenType::COMMA); break;
-            case '.': add_token(TokenType::DOT); break;
-            case '-': add_token(TokenType::SUB); break;
-            case '+': add_token(TokenType::ADD); break;
-            case '*': add_token(TokenType::MUL); break;
-            case '/': add_token(TokenType::DIV); break;
-            case ';': add_token(TokenType::SEMICOLON); break;
-            case '!': add_token(match('=') ? TokenType::NOT_EQUAL : TokenType::NOT); break;
-            case '=': add_token(match('=') ? TokenType::EQUAL_EQUAL : TokenType::EQUAL); break;
-            case '<': add_token(match('=') ? TokenType::LESS_EQUAL : TokenType::LESS); break;
-            case '>': add_token(match('=') ? TokenType::GREATER_EQUAL : TokenType::GREATER); break;
-            case ' ':
-            case '\r':
-            case '\t':
-            break;
-            case '\n':
-            line++;
-            break;
-            case '"': string(); break;
-            default:
-            {
-                if (isdigit(ch)) 
-                number();
-                else if (isalpha(ch) || ch == '_') 
-                identifier();
-                else 
-                throw std::runtime_error("SYNTAX ERROR : Unexpected character at line " + std::to_string(line));
-                break;
-            }
-        }
-    }
-    void string()
-    {
-        while (peek() != '"' && !isAtEnd())
-        {
-            if (peek() == '\n') line++;
-            advance();
-        }
-        if (isAtEnd()) 
-        throw std::runtime_error("SYNTAX ERROR : Unterminated string at line " + std::to_string(line));
-        advance();
-        std::string value = source.substr(start + 1, current - start - 2);
-        add_token(TokenType::STRING, value);
-    }
-    void number()
-    {
-        while (isdigit(peek())) 
-        advance();
-        if (peek() == '.' && isdigit(peek_next()))
-        {
-            advance();
-            while (isdigit(peek())) 
-            advance();
-        }
-        std::string num = source.substr(start, current - start);
-        try 
-        { 
-            add_token(TokenType::NUMBER, std::stod(num)); 
-        }
-        catch (...) 
-        { 
-            throw std::runtime_error("RUNTIME ERROR : Unexpected number at line " + std::to_string(line)); 
-        }
-    }
-    void identifier()
-    {
-        while (isalnum(peek()) || peek() == '_') 
-        advance();
-        std::string text = source.substr(start, current - start);
-        TokenType type = TokenType::IDENTIFIER;
-        if (keywords.find(text) != keywords.end()) type = keywords[text];
-        add_token(type);
-    }
-};
-std::unordered_map<std::string, TokenType> scanner::keywords = 
-{
-    {"and", AND}, 
-    {"else", ELSE}, 
-    {"false", FALSE},
-    {"for", FOR}, 
-    {"fun", FUN}, 
-    {"if", IF}, 
-    {"nil", NIL},
-    {"or", OR}, 
-    {"print", PRINT}, 
-    {"return", RETURN},
-    {"this", THIS}, 
-    {"true", TRUE}, 
-    {"var", VAR}, 
-    {"while", WHILE}
-};
-#endif
\ No newline at end of file
+#ifndef scanner_hpp
+#define scanner_hpp
+#include <array>
+#include <algorithm>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <charconv>
+#include <iostream>
+#include <stdexcept>
+#include <unordered_map>
+#include "value.hpp"
+#if defined(__SSE2__) && !defined(METAL_NO_SIMD)
+#include <emmintrin.h>
+#define METAL_SIMD 1
+#endif
+
+enum TokenType
+{
+    LEFT_PAREN, RIGHT_PAREN,
+    LEFT_BRACE, RIGHT_BRACE,
+    COMMA, DOT, SUB, ADD, SEMICOLON, DIV, MUL,
+    NOT,  NOT_EQUAL,
+    EQUAL, EQUAL_EQUAL,
+    GREATER, GREATER_EQUAL,
+    LESS, LESS_EQUAL,
+    IDENTIFIER, STRING, NUMBER,
+    AND, CLASS, ELSE, FALSE, FUN, FOR, IF, NIL, OR,
+    PRINT, RETURN, SUPER, THIS, TRUE, VAR, WHILE,
+    ERROR_TOKEN, EOF_TOKEN
+};
+
+struct Token
+{
+    std::string_view lexeme;
+    TokenType type;
+    int line;
+    union
+    {
+        double number;
+        uint32_t symbol;
+    };
+};
+
+struct SymbolTable
+{
+    std::deque<std::string> names;
+    std::unordered_map<std::string_view, uint32_t> ids;
+    uint32_t intern(std::string_view name)
+    {
+        auto found = ids.find(name);
+        if(found != ids.end())
+        return found->second;
+        names.emplace_back(name);
+        uint32_t id = names.size() - 1;
+        ids.emplace(names.back(), id);
+        return id;
+    }
+    const std::string& name(uint32_t id) const
+    {
+        return names[id];
+    }
+};
+
+class scanner
+{
+    public:
+    scanner(std::string_view source, SymbolTable& symbols):
+    source(source), symbols(symbols){}
+    static constexpr uint8_t SPACE = 1;
+    static constexpr uint8_t DIGIT = 2;
+    static constexpr uint8_t ALPHA = 4;
+    static constexpr std::array<uint8_t, 256> classes = []()
+    {
+        std::array<uint8_t, 256> table{};
+        table[' '] = table['\t'] = table['\r'] = table['\n'] = SPACE;
+        for(int c = '0'; c <= '9'; c++)
+        table[c] = DIGIT;
+        for(int c = 'a'; c <= 'z'; c++)
+        table[c] = table[c - 'a' + 'A'] = ALPHA;
+        table['_'] = ALPHA;
+        return table;
+    }();
+    size_t start = 0;
+    size_t current = 0;
+    int line = 1;
+    std::string_view source;
+    SymbolTable& symbols;
+    Token token;
+    bool produced = false;
+    std::vector<Token> scan_tokens()
+    {
+        std::vector<Token> tokens;
+        tokens.reserve(source.size() / 3 + 1);
+        do
+        {
+            tokens.push_back(next());
+        }
+        while(tokens.back().type != TokenType::EOF_TOKEN);
+        return tokens;
+    }
+    Token next()
+    {
+        produced = false;
+        while(!produced)
+        {
+            skip_whitespace();
+            if(isAtEnd())
+            break;
+            start = current;
+            scan_token();
+        }
+        if(!produced)
+        token = Token{std::string_view(), TokenType::EOF_TOKEN, line, {}};
+        return token;
+    }
+    bool isAtEnd()
+    {
+        if(current >= source.size())
+        return true;
+        return false;
+    }
+    Token& add_token(TokenType type)
+    {
+        token = Token{source.substr(start, current - start), type, line, {}};
+        produced = true;
+        return token;
+    }
+    void error_token(std::string_view message)
+    {
+        token = Token{message, TokenType::ERROR_TOKEN, line, {}};
+        produced = true;
+    }
+    bool match(char expected)
+    {
+        if(isAtEnd() == true)
+        return false;
+        if(source[current] != expected)
+        return false;
+        current++;
+        return true;
+    }
+    char peek()
+    {
+        if(isAtEnd() == true)
+        return '\0';
+        else
+        return source[current];
+    }
+    char peek_next()
+    {
+        if(current + 1 >= source.size())
+        return '\0';
+        return source[current + 1];
+    }
+    char advance()
+    {
+        if(isAtEnd())
+        return '\0';
+        char curr = source[current];
+        current++;
+        return curr;
+    }
+    static uint8_t classOf(char ch)
+    {
+        return classes[static_cast<uint8_t>(ch)];
+    }
+    #if defined(METAL_SIMD)
+    static __m128i inRange(__m128i block, char low, char high)
+    {
+        __m128i offset = _mm_sub_epi8(block, _mm_set1_epi8(low));
+        return _mm_cmpeq_epi8(_mm_min_epu8(offset, _mm_set1_epi8(high - low)), offset);
+    }
+    static uint32_t spaceMask(__m128i block)
+    {
+        __m128i spaces = _mm_or_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(block, _mm_set1_epi8('\n')));
+        __m128i controls = _mm_or_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8('\t')), _mm_cmpeq_epi8(block, _mm_set1_epi8('\r')));
+        return _mm_movemask_epi8(_mm_or_si128(spaces, controls));
+    }
+    static uint32_t digitMask(__m128i block)
+    {
+        return _mm_movemask_epi8(inRange(block, '0', '9'));
+    }
+    static uint32_t wordMask(__m128i block)
+    {
+        __m128i letters = inRange(_mm_or_si128(block, _mm_set1_epi8(0x20)), 'a', 'z');
+        __m128i underscores = _mm_cmpeq_epi8(block, _mm_set1_epi8('_'));
+        return _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(letters, underscores), inRange(block, '0', '9')));
+    }
+    static uint32_t newlineMask(__m128i block)
+    {
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(block, _mm_set1_epi8('\n')));
+    }
+    __m128i load(size_t at) const
+    {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i*>(source.data() + at));
+    }
+    #endif
+    static constexpr size_t SCALAR_PREFIX = 8;
+    void skip_whitespace()
+    {
+        size_t at = current;
+        size_t size = source.size();
+        size_t prefix = std::min(size, at + SCALAR_PREFIX);
+        for(; at < prefix && classOf(source[at]) == SPACE; at++)
+        {
+            if(source[at] == '\n')
+            line++;
+        }
+        if(at < prefix)
+        {
+            current = at;
+            return;
+        }
+        #if defined(METAL_SIMD)
+        for(; at + 16 <= size; at += 16)
+        {
+            __m128i block = load(at);
+            uint32_t run = __builtin_ctz(~spaceMask(block));
+            uint32_t newlines = newlineMask(block);
+            if(run < 16)
+            {
+                line += __builtin_popcount(newlines & ((1u << run) - 1));
+                current = at + run;
+                return;
+            }
+            line += __builtin_popcount(newlines);
+        }
+        #endif
+        for(; at < size && classOf(source[at]) == SPACE; at++)
+        {
+            if(source[at] == '\n')
+            line++;
+        }
+        current = at;
+    }
+    size_t skip(size_t at, uint8_t kinds) const
+    {
+        size_t size = source.size();
+        size_t prefix = std::min(size, at + SCALAR_PREFIX);
+        while(at < prefix && (classOf(source[at]) & kinds) != 0)
+        at++;
+        if(at < prefix)
+        return at;
+        #if defined(METAL_SIMD)
+        for(; at + 16 <= size; at += 16)
+        {
+            __m128i block = load(at);
+            uint32_t run = __builtin_ctz(~(kinds == DIGIT ? digitMask(block) : wordMask(block)));
+            if(run < 16)
+            return at + run;
+        }
+        #endif
+        while(at < size && (classOf(source[at]) & kinds) != 0)
+        at++;
+        return at;
+    }
+    void scan_token()
+    {
+        char ch = advance();
+        switch(ch)
+        {
+            case '(': add_token(TokenType::LEFT_PAREN); break;
+            case '{': add_token(TokenType::LEFT_BRACE); break;
+            case ')': add_token(TokenType::RIGHT_PAREN); break;
+            case '}': add_token(TokenType::RIGHT_BRACE); break;
+            case ',': add_token(TokenType::COMMA); break;
+            case '.': add_token(TokenType::DOT); break;
+            case '-': add_token(TokenType::SUB); break;
+            case '+': add_token(TokenType::ADD); break;
+            case '*': add_token(TokenType::MUL); break;
+            case '/': add_token(TokenType::DIV); break;
+            case ';': add_token(TokenType::SEMICOLON); break;
+            case '!': add_token(match('=') ? TokenType::NOT_EQUAL : TokenType::NOT); break;
+            case '=': add_token(match('=') ? TokenType::EQUAL_EQUAL : TokenType::EQUAL); break;
+            case '<': add_token(match('=') ? TokenType::LESS_EQUAL : TokenType::LESS); break;
+            case '>': add_token(match('=') ? TokenType::GREATER_EQUAL : TokenType::GREATER); break;
+            case ' ':
+            case '\r':
+            case '\t':
+            break;
+            case '\n':
+            line++;
+            break;
+            case '"': string(); break;
+            default:
+            {
+                uint8_t kind = classOf(ch);
+                if (kind == DIGIT) 
+                number();
+                else if (kind == ALPHA) 
+                identifier();
+                else 
+                error_token("SYNTAX ERROR : Unexpected character");
+                break;
+            }
+        }
+    }
+    void string()
+    {
+        size_t at = current;
+        size_t size = source.size();
+        size_t prefix = std::min(size, at + SCALAR_PREFIX);
+        for(; at < prefix && source[at] != '"'; at++)
+        {
+            if(source[at] == '\n')
+            line++;
+        }
+        #if defined(METAL_SIMD)
+        bool open = at == prefix;
+        for(; open && at + 16 <= size; at += 16)
+        {
+            __m128i block = load(at);
+            uint32_t quotes = _mm_movemask_epi8(_mm_cmpeq_epi8(block, _mm_set1_epi8('"')));
+            uint32_t newlines = newlineMask(block);
+            if(quotes != 0)
+            {
+                uint32_t run = __builtin_ctz(quotes);
+                line += __builtin_popcount(newlines & ((1u << run) - 1));
+                at += run;
+                break;
+            }
+            line += __builtin_popcount(newlines);
+        }
+        #endif
+        for(; at < size && source[at] != '"'; at++)
+        {
+            if(source[at] == '\n')
+            line++;
+        }
+        current = at;
+        if (isAtEnd()) 
+        {
+            error_token("SYNTAX ERROR : Unterminated string");
+            return;
+        }
+        advance();
+        add_token(TokenType::STRING);
+    }
+    void number()
+    {
+        current = skip(current, DIGIT);
+        if (peek() == '.' && classOf(peek_next()) == DIGIT)
+        {
+            advance();
+            current = skip(current, DIGIT);
+        }
+        double value;
+        std::from_chars_result result = std::from_chars(source.data() + start, source.data() + current, value);
+        if(result.ec != std::errc())
+        error_token("RUNTIME ERROR : Unexpected number");
+        else
+        add_token(TokenType::NUMBER).number = value;
+    }
+    void identifier()
+    {
+        current = skip(current, ALPHA | DIGIT);
+        std::string_view text = source.substr(start, current - start);
+        TokenType type = keyword(text);
+        if(type == TokenType::IDENTIFIER)
+        add_token(type).symbol = symbols.intern(text);
+        else
+        add_token(type);
+    }
+    static TokenType keyword(std::string_view text)
+    {
+        switch(text.size())
+        {
+            case 2:
+            switch(text[0])
+            {
+                case 'i': if(text == "if") return IF; break;
+                case 'o': if(text == "or") return OR; break;
+            }
+            break;
+            case 3:
+            switch(text[0])
+            {
+                case 'a': if(text == "and") return AND; break;
+                case 'f':
+                if(text == "for") return FOR;
+                if(text == "fun") return FUN;
+                break;
+                case 'n': if(text == "nil") return NIL; break;
+                case 'v': if(text == "var") return VAR; break;
+            }
+            break;
+            case 4:
+            switch(text[0])
+            {
+                case 'e': if(text == "else") return ELSE; break;
+                case 't':
+                if(text == "this") return THIS;
+                if(text == "true") return TRUE;
+                break;
+            }
+            break;
+            case 5:
+            switch(text[0])
+            {
+                case 'f': if(text == "false") return FALSE; break;
+                case 'p': if(text == "print") return PRINT; break;
+                case 'w': if(text == "while") return WHILE; break;
+            }
+            break;
+            case 6:
+            if(text == "return") return RETURN;
+            break;
+        }
+        return IDENTIFIER;
+    }
+};
+#endif
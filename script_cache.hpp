@@ -0,0 +1,424 @@
+#ifndef script_cache_hpp
+#define script_cache_hpp
+#include <cstdio>
+#include <fstream>
+#include <unistd.h>
+#include <filesystem>
+#include "metal.hpp"
+#include "mapped_file.hpp"
+
+struct ScriptCache
+{
+    static constexpr uint32_t MAGIC = 0x434c544d;
+    static constexpr uint32_t FORMAT = 3;
+    static constexpr uint32_t VERSION = FORMAT << 8 | OP_HALT;
+    enum Tag : uint8_t { NIL, BOOL, NUMBER, STRING, FUNCTION };
+    struct Reader
+    {
+        const char* cursor;
+        const char* end;
+        bool ok = true;
+        template<typename T>
+        T read()
+        {
+            T value{};
+            if(end - cursor < (ptrdiff_t)sizeof(T))
+            {
+                ok = false;
+                return value;
+            }
+            std::memcpy(&value, cursor, sizeof(T));
+            cursor += sizeof(T);
+            return value;
+        }
+        std::string_view bytes(size_t size)
+        {
+            if(end - cursor < (ptrdiff_t)size)
+            {
+                ok = false;
+                return std::string_view();
+            }
+            std::string_view text(cursor, size);
+            cursor += size;
+            return text;
+        }
+        std::string_view text()
+        {
+            return bytes(read<uint32_t>());
+        }
+    };
+    struct Writer
+    {
+        std::string buffer;
+        template<typename T>
+        void write(const T& value)
+        {
+            buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+        }
+        void text(std::string_view text)
+        {
+            write<uint32_t>(text.size());
+            buffer.append(text);
+        }
+    };
+    std::string directory;
+    ScriptCache(std::string directory):
+    directory(std::move(directory)){}
+    static uint64_t hash(std::string_view data)
+    {
+        uint64_t h = 0x9e3779b97f4a7c15ull ^ data.size();
+        size_t i = 0;
+        for(; i + 8 <= data.size(); i += 8)
+        {
+            uint64_t word;
+            std::memcpy(&word, data.data() + i, 8);
+            h = (h ^ word) * 0xff51afd7ed558ccdull;
+            h ^= h >> 32;
+        }
+        for(; i < data.size(); i++)
+        h = (h ^ (uint8_t)data[i]) * 0x100000001b3ull;
+        h ^= h >> 29;
+        h *= 0xc4ceb9fe1a85ec53ull;
+        h ^= h >> 32;
+        return h;
+    }
+    static uint32_t flags(const Engine& engine)
+    {
+        return engine.optimize ? 1 : 0;
+    }
+    std::string path(uint64_t key) const
+    {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.mtc", (unsigned long long)key);
+        return directory + "/" + name;
+    }
+    std::unique_ptr<Script> load(Engine& engine, std::string_view source)
+    {
+        uint64_t key = hash(source);
+        MappedFile file;
+        if(!file.open(path(key)))
+        return nullptr;
+        Reader in{file.data, file.data + file.size};
+        if(in.read<uint32_t>() != MAGIC || in.read<uint32_t>() != VERSION || in.read<uint32_t>() != flags(engine))
+        return nullptr;
+        if(in.read<uint64_t>() != source.size() || in.read<uint64_t>() != key || in.bytes(source.size()) != source)
+        return nullptr;
+        uint64_t checksum = in.read<uint64_t>();
+        if(!in.ok || checksum != hash(std::string_view(in.cursor, in.end - in.cursor)))
+        return nullptr;
+        std::unique_ptr<Script> script = std::make_unique<Script>();
+        Chunk& chunk = script->chunk;
+        uint32_t globals = in.read<uint32_t>();
+        if(globals > (size_t)(in.end - in.cursor))
+        return nullptr;
+        std::vector<std::string_view> names(globals);
+        for(uint32_t i = 0; i < globals && in.ok; i++)
+        names[i] = in.text();
+        script->globals = globals;
+        uint32_t declared = in.read<uint32_t>();
+        if(declared > (size_t)(in.end - in.cursor))
+        return nullptr;
+        std::vector<const Function*> functions(declared);
+        for(size_t i = 0; i < functions.size() && in.ok; i++)
+        {
+            std::string_view name = in.text();
+            char* text = static_cast<char*>(script->arena.allocate(name.size(), 1));
+            if(!name.empty())
+            std::memcpy(text, name.data(), name.size());
+            Token token{};
+            token.lexeme = std::string_view(text, name.size());
+            token.type = TokenType::IDENTIFIER;
+            token.line = in.read<int>();
+            uint32_t arity = in.read<uint32_t>();
+            Function* function = script->arena.create<Function>(script->arena.copy(token), nullptr, arity, nullptr, 0);
+            function->line = token.line;
+            function->slots = in.read<uint32_t>();
+            function->entry = in.read<uint32_t>();
+            function->maxStack = in.read<int>();
+            function->chunk = &chunk;
+            functions[i] = function;
+        }
+        chunk.maxStack = in.read<int>();
+        chunk.frameSize = in.read<uint32_t>();
+        std::string_view code = in.text();
+        chunk.code.assign(code.begin(), code.end());
+        uint32_t runs = in.read<uint32_t>();
+        chunk.lines.reserve(code.size());
+        for(uint32_t i = 0; i < runs && in.ok; i++)
+        {
+            uint32_t count = in.read<uint32_t>();
+            int line = in.read<int>();
+            if(count > code.size() - chunk.lines.size())
+            return nullptr;
+            chunk.lines.insert(chunk.lines.end(), count, line);
+        }
+        uint32_t constants = in.read<uint32_t>();
+        if(constants > (size_t)(in.end - in.cursor))
+        return nullptr;
+        chunk.constants.reserve(constants);
+        for(uint32_t i = 0; i < constants && in.ok; i++)
+        {
+            switch(in.read<uint8_t>())
+            {
+                case NIL: chunk.constants.emplace_back(); break;
+                case BOOL: chunk.constants.emplace_back(in.read<uint8_t>() != 0); break;
+                case NUMBER: chunk.constants.emplace_back(in.read<double>()); break;
+                case STRING:
+                {
+                    StringObject* text = script->arena.create<StringObject>(std::string(in.text()));
+                    chunk.constants.push_back(Value::constant(text));
+                    break;
+                }
+                case FUNCTION:
+                {
+                    uint32_t index = in.read<uint32_t>();
+                    if(index >= functions.size())
+                    return nullptr;
+                    chunk.constants.emplace_back(functions[index]);
+                    break;
+                }
+                default:
+                return nullptr;
+            }
+        }
+        if(!in.ok || chunk.lines.size() != chunk.code.size() || !verify(chunk, globals, functions))
+        return nullptr;
+        resolver::Mark mark = engine.resolver1.mark();
+        engine.symbols.ids.reserve(engine.symbols.ids.size() + globals);
+        for(uint32_t i = 0; i < globals; i++)
+        {
+            if(engine.declare(names[i]) != i)
+            {
+                engine.resolver1.rollback(mark);
+                return nullptr;
+            }
+        }
+        return script;
+    }
+    static bool verify(const Chunk& chunk, uint32_t globals, const std::vector<const Function*>& functions)
+    {
+        const std::vector<uint8_t>& code = chunk.code;
+        if(code.empty() || chunk.maxStack < 0 || (size_t)chunk.maxStack > code.size() || chunk.frameSize > code.size())
+        return false;
+        std::vector<uint32_t> regions(code.size(), 0);
+        std::vector<std::pair<uint32_t, int>> pending(1, {0, 0});
+        for(uint32_t i = 0; i < functions.size(); i++)
+        {
+            const Function* function = functions[i];
+            if(function->arity > 255 || function->slots < function->arity || function->slots - function->arity > code.size())
+            return false;
+            if(function->maxStack < 0 || (size_t)function->maxStack > code.size())
+            return false;
+            uint32_t entry = function->entry;
+            if(entry < 5 || entry >= code.size() || code[entry - 5] != OP_JUMP)
+            return false;
+            uint32_t end;
+            std::memcpy(&end, &code[entry - 4], 4);
+            if(end <= entry || end > code.size())
+            return false;
+            for(uint32_t at = entry; at < end; at++)
+            {
+                if(regions[at] != 0)
+                return false;
+                regions[at] = i + 1;
+            }
+            pending.push_back({entry, 0});
+        }
+        std::vector<int> depths(code.size(), -1);
+        while(!pending.empty())
+        {
+            uint32_t at = pending.back().first;
+            int depth = pending.back().second;
+            pending.pop_back();
+            while(depths[at] != depth)
+            {
+                if(depths[at] != -1)
+                return false;
+                depths[at] = depth;
+                uint32_t region = regions[at];
+                uint32_t slots = region == 0 ? chunk.frameSize : functions[region - 1]->slots;
+                int limit = region == 0 ? chunk.maxStack : functions[region - 1]->maxStack;
+                uint8_t op = code[at++];
+                uint32_t operand = 0;
+                switch(op)
+                {
+                    case OP_CONSTANT: case OP_DEFINE_GLOBAL: case OP_GET_GLOBAL: case OP_SET_GLOBAL:
+                    case OP_DEFINE_LOCAL: case OP_GET_LOCAL: case OP_SET_LOCAL:
+                    case OP_JUMP: case OP_JUMP_IF_FALSE: case OP_JUMP_IF_TRUE: case OP_LOOP:
+                    case OP_CALL:
+                    if(code.size() - at < 4)
+                    return false;
+                    std::memcpy(&operand, &code[at], 4);
+                    at += 4;
+                    break;
+                }
+                int needs = 0;
+                int effect = 0;
+                bool jumps = false;
+                bool ends = false;
+                switch(op)
+                {
+                    case OP_CONSTANT:
+                    if(operand >= chunk.constants.size())
+                    return false;
+                    effect = 1;
+                    break;
+                    case OP_NIL: case OP_TRUE: case OP_FALSE:
+                    effect = 1;
+                    break;
+                    case OP_POP: case OP_PRINT:
+                    needs = 1;
+                    effect = -1;
+                    break;
+                    case OP_DEFINE_GLOBAL: case OP_GET_GLOBAL: case OP_SET_GLOBAL:
+                    if(operand >= globals)
+                    return false;
+                    needs = op == OP_GET_GLOBAL ? 0 : 1;
+                    effect = op == OP_DEFINE_GLOBAL ? -1 : op == OP_GET_GLOBAL ? 1 : 0;
+                    break;
+                    case OP_DEFINE_LOCAL: case OP_GET_LOCAL: case OP_SET_LOCAL:
+                    if(operand >= slots)
+                    return false;
+                    needs = op == OP_GET_LOCAL ? 0 : 1;
+                    effect = op == OP_DEFINE_LOCAL ? -1 : op == OP_GET_LOCAL ? 1 : 0;
+                    break;
+                    case OP_EQUAL: case OP_NOT_EQUAL:
+                    case OP_GREATER: case OP_GREATER_EQUAL: case OP_LESS: case OP_LESS_EQUAL:
+                    case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV:
+                    needs = 2;
+                    effect = -1;
+                    break;
+                    case OP_NOT: case OP_NEGATE:
+                    needs = 1;
+                    break;
+                    case OP_JUMP: case OP_LOOP:
+                    jumps = true;
+                    ends = true;
+                    break;
+                    case OP_JUMP_IF_FALSE: case OP_JUMP_IF_TRUE:
+                    needs = 1;
+                    jumps = true;
+                    break;
+                    case OP_CALL:
+                    if(operand > 255)
+                    return false;
+                    needs = operand + 1;
+                    effect = -(int)operand;
+                    break;
+                    case OP_RETURN:
+                    if(region == 0)
+                    return false;
+                    needs = 1;
+                    ends = true;
+                    break;
+                    case OP_HALT:
+                    if(region != 0)
+                    return false;
+                    ends = true;
+                    break;
+                    default:
+                    return false;
+                }
+                if(depth < needs || depth + effect > limit)
+                return false;
+                depth += effect;
+                if(jumps == true)
+                {
+                    if(operand >= code.size() || regions[operand] != region)
+                    return false;
+                    pending.push_back({operand, depth});
+                }
+                if(ends == true)
+                break;
+                if(at >= code.size() || regions[at] != region)
+                return false;
+            }
+        }
+        return true;
+    }
+    bool store(const Engine& engine, const Script& script, std::string_view source)
+    {
+        const Chunk& chunk = script.chunk;
+        if(!script.ok() || chunk.code.empty())
+        return false;
+        uint64_t key = hash(source);
+        Writer out;
+        out.write(MAGIC);
+        out.write(VERSION);
+        out.write(flags(engine));
+        out.write<uint64_t>(source.size());
+        out.write(key);
+        out.buffer.append(source);
+        size_t checksumAt = out.buffer.size();
+        out.write<uint64_t>(0);
+        std::vector<std::string_view> names(script.globals);
+        for(uint32_t symbol = 0; symbol < engine.resolver1.globalSlots.size(); symbol++)
+        {
+            int32_t slot = engine.resolver1.globalSlots[symbol];
+            if(slot >= 0 && (size_t)slot < names.size())
+            names[slot] = engine.symbols.names[symbol];
+        }
+        out.write<uint32_t>(names.size());
+        for(std::string_view name : names)
+        out.text(name);
+        std::vector<const Function*> functions;
+        for(const Value& constant : chunk.constants)
+        {
+            if(constant.isFunction())
+            functions.push_back(constant.asFunction());
+        }
+        out.write<uint32_t>(functions.size());
+        for(const Function* function : functions)
+        {
+            out.text(function->name->lexeme);
+            out.write<int>(function->name->line);
+            out.write<uint32_t>(function->arity);
+            out.write<uint32_t>(function->slots);
+            out.write<uint32_t>(function->entry);
+            out.write<int>(function->maxStack);
+        }
+        out.write<int>(chunk.maxStack);
+        out.write<uint32_t>(chunk.frameSize);
+        out.text(std::string_view(reinterpret_cast<const char*>(chunk.code.data()), chunk.code.size()));
+        size_t runsAt = out.buffer.size();
+        uint32_t runs = 0;
+        out.write(runs);
+        for(size_t i = 0; i < chunk.lines.size();)
+        {
+            size_t j = i;
+            while(j < chunk.lines.size() && chunk.lines[j] == chunk.lines[i])
+            j++;
+            out.write<uint32_t>(j - i);
+            out.write<int>(chunk.lines[i]);
+            runs++;
+            i = j;
+        }
+        std::memcpy(&out.buffer[runsAt], &runs, sizeof(runs));
+        out.write<uint32_t>(chunk.constants.size());
+        uint32_t function = 0;
+        for(const Value& constant : chunk.constants)
+        {
+            switch(constant.type)
+            {
+                case ValueType::NIL: out.write<uint8_t>(NIL); break;
+                case ValueType::BOOL: out.write<uint8_t>(BOOL); out.write<uint8_t>(constant.asBool()); break;
+                case ValueType::NUMBER: out.write<uint8_t>(NUMBER); out.write(constant.asNumber()); break;
+                case ValueType::STRING: out.write<uint8_t>(STRING); out.text(constant.asString()); break;
+                case ValueType::FUNCTION: out.write<uint8_t>(FUNCTION); out.write(function++); break;
+            }
+        }
+        uint64_t checksum = hash(std::string_view(out.buffer).substr(checksumAt + sizeof(checksum)));
+        std::memcpy(&out.buffer[checksumAt], &checksum, sizeof(checksum));
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+        std::string target = path(key);
+        std::string temporary = target + "." + std::to_string(getpid());
+        {
+            std::ofstream file(temporary, std::ios::binary);
+            if(!file.write(out.buffer.data(), out.buffer.size()))
+            return false;
+        }
+        return std::rename(temporary.c_str(), target.c_str()) == 0;
+    }
+};
+#endif
@@ -0,0 +1,324 @@
+#ifndef value_hpp
+#define value_hpp
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+#include <vector>
+#include <string_view>
+#include <unordered_map>
+#include <charconv>
+#include <stdexcept>
+
+enum class ValueType : uint8_t
+{
+    NIL, BOOL, NUMBER, STRING, FUNCTION
+};
+
+struct Function;
+struct InternTable;
+class LimitError : public std::runtime_error
+{
+    public:
+    LimitError(const char* message):
+    std::runtime_error(message){}
+};
+
+struct StringObject
+{
+    static constexpr int IMMORTAL = -1;
+    static constexpr size_t SHORT = 15;
+    static constexpr size_t FLAT = 64;
+    int refs;
+    const InternTable* table = nullptr;
+    size_t length;
+    StringObject* left = nullptr;
+    StringObject* right = nullptr;
+    std::string text;
+    struct Usage
+    {
+        size_t allocations = 0;
+        size_t bytes = 0;
+        long long live = 0;
+        long long peak = 0;
+        size_t ceiling = 0;
+        void allocated(size_t size)
+        {
+            if(ceiling != 0 && bytes + size > ceiling)
+            throw LimitError("Memory limit exceeded.");
+            allocations++;
+            bytes += size;
+            live += size;
+            if(live > peak)
+            peak = live;
+        }
+    };
+    StringObject(std::string text):
+    refs(1), length(text.size()), text(std::move(text))
+    {
+        usage().allocated(sizeof(StringObject) + length);
+    }
+    StringObject(StringObject* left, StringObject* right):
+    refs(1), length(left->length + right->length), left(left), right(right)
+    {
+        usage().allocated(sizeof(StringObject));
+    }
+    ~StringObject()
+    {
+        usage().live -= sizeof(StringObject) + text.size();
+    }
+    static Usage& usage()
+    {
+        thread_local Usage totals;
+        return totals;
+    }
+    bool isRope() const
+    {
+        return left != nullptr;
+    }
+    void retain()
+    {
+        if(refs != IMMORTAL)
+        refs++;
+    }
+    static void release(StringObject* string)
+    {
+        if(string->refs == IMMORTAL || --string->refs > 0)
+        return;
+        if(!string->isRope())
+        {
+            delete string;
+            return;
+        }
+        std::vector<StringObject*> dead(1, string);
+        while(!dead.empty())
+        {
+            StringObject* node = dead.back();
+            dead.pop_back();
+            for(StringObject* child : {node->left, node->right})
+            {
+                if(child != nullptr && child->refs != IMMORTAL && --child->refs == 0)
+                dead.push_back(child);
+            }
+            delete node;
+        }
+    }
+    const std::string& flat()
+    {
+        if(isRope())
+        flatten();
+        return text;
+    }
+    void flatten()
+    {
+        usage().allocated(length);
+        std::string result;
+        result.reserve(length);
+        std::vector<const StringObject*> pending(1, this);
+        while(!pending.empty())
+        {
+            const StringObject* node = pending.back();
+            pending.pop_back();
+            if(node->isRope())
+            {
+                pending.push_back(node->right);
+                pending.push_back(node->left);
+            }
+            else
+            result += node->text;
+        }
+        release(left);
+        release(right);
+        left = right = nullptr;
+        text = std::move(result);
+    }
+    static StringObject* make(std::string text);
+    static StringObject* concat(StringObject* left, StringObject* right)
+    {
+        if(right->length == 0)
+        {
+            left->retain();
+            return left;
+        }
+        if(left->length == 0)
+        {
+            right->retain();
+            return right;
+        }
+        if(left->length > std::string().max_size() - right->length)
+        throw LimitError("String too long.");
+        if(left->length + right->length <= FLAT)
+        return make(left->flat() + right->flat());
+        StringObject* node = new StringObject(left, right);
+        left->retain();
+        right->retain();
+        return node;
+    }
+};
+
+struct InternTable
+{
+    static constexpr size_t CAPACITY = 1 << 16;
+    std::unordered_map<std::string_view, StringObject*> strings;
+    ~InternTable()
+    {
+        for(auto& entry : strings)
+        StringObject::release(entry.second);
+    }
+    StringObject* intern(std::string text)
+    {
+        auto found = strings.find(text);
+        if(found != strings.end())
+        {
+            found->second->refs++;
+            return found->second;
+        }
+        StringObject* string = new StringObject(std::move(text));
+        if(strings.size() < CAPACITY)
+        {
+            string->table = this;
+            string->refs++;
+            strings.emplace(string->text, string);
+        }
+        return string;
+    }
+};
+
+inline StringObject* StringObject::make(std::string text)
+{
+    if(text.size() > SHORT)
+    return new StringObject(std::move(text));
+    thread_local InternTable table;
+    return table.intern(std::move(text));
+}
+
+struct Value
+{
+    ValueType type;
+    union
+    {
+        bool boolean;
+        double number;
+        StringObject* string;
+        const Function* function;
+    } as;
+    Value():
+    type(ValueType::NIL){ as.number = 0; }
+    Value(std::nullptr_t):
+    type(ValueType::NIL){ as.number = 0; }
+    Value(bool boolean):
+    type(ValueType::BOOL){ as.number = 0; as.boolean = boolean; }
+    Value(double number):
+    type(ValueType::NUMBER){ as.number = number; }
+    Value(std::string text):
+    type(ValueType::STRING){ as.string = StringObject::make(std::move(text)); }
+    Value(StringObject* string):
+    type(ValueType::STRING){ as.string = string; }
+    Value(const char* text):
+    Value(std::string(text)){}
+    Value(const Function* function):
+    type(ValueType::FUNCTION){ as.function = function; }
+    Value(const Value& other):
+    type(other.type), as(other.as)
+    {
+        if(type == ValueType::STRING)
+        as.string->retain();
+    }
+    Value(Value&& other) noexcept:
+    type(other.type), as(other.as)
+    {
+        other.type = ValueType::NIL;
+    }
+    Value& operator=(const Value& other)
+    {
+        if(other.type == ValueType::STRING)
+        other.as.string->retain();
+        release();
+        type = other.type;
+        as = other.as;
+        return *this;
+    }
+    Value& operator=(Value&& other) noexcept
+    {
+        if(this != &other)
+        {
+            release();
+            type = other.type;
+            as = other.as;
+            other.type = ValueType::NIL;
+        }
+        return *this;
+    }
+    ~Value()
+    {
+        release();
+    }
+    void release()
+    {
+        if(type == ValueType::STRING)
+        StringObject::release(as.string);
+    }
+    static Value constant(StringObject* string)
+    {
+        string->refs = StringObject::IMMORTAL;
+        Value value;
+        value.type = ValueType::STRING;
+        value.as.string = string;
+        return value;
+    }
+    bool isNil() const { return type == ValueType::NIL; }
+    bool isBool() const { return type == ValueType::BOOL; }
+    bool isNumber() const { return type == ValueType::NUMBER; }
+    bool isString() const { return type == ValueType::STRING; }
+    bool isFunction() const { return type == ValueType::FUNCTION; }
+    bool asBool() const { return as.boolean; }
+    double asNumber() const { return as.number; }
+    const std::string& asString() const { return as.string->flat(); }
+    const Function* asFunction() const { return as.function; }
+};
+inline char* formatNumber(char* buffer, double number)
+{
+    if(number != 0 && number > -9007199254740992.0 && number < 9007199254740992.0 && number == (int64_t)number)
+    return std::to_chars(buffer, buffer + 32, (int64_t)number).ptr;
+    return std::to_chars(buffer, buffer + 32, number).ptr;
+}
+inline Value concatenate(const Value& a, const Value& b)
+{
+    return Value(StringObject::concat(a.as.string, b.as.string));
+}
+inline bool isTrue(const Value& expression)
+{
+    if(expression.isNil())
+    return false;
+    if(expression.isBool())
+    return expression.asBool();
+    return true;
+}
+inline bool isEqual(const Value& a, const Value& b) 
+{
+    if (a.type != b.type)
+    return false;
+    switch(a.type)
+    {
+        case ValueType::NIL:
+        return true;
+        case ValueType::NUMBER:
+        return a.asNumber() == b.asNumber();
+        case ValueType::BOOL:
+        return a.asBool() == b.asBool();
+        case ValueType::STRING:
+        {
+            if(a.as.string == b.as.string)
+            return true;
+            if(a.as.string->length != b.as.string->length)
+            return false;
+            if(a.as.string->table != nullptr && a.as.string->table == b.as.string->table)
+            return false;
+            return a.asString() == b.asString();
+        }
+        case ValueType::FUNCTION:
+        return a.as.function == b.as.function;
+    }
+    return false;
+}
+#endif
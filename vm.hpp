@@ -0,0 +1,555 @@
+#ifndef vm_hpp
+#define vm_hpp
+#include <cstring>
+#include "parser.hpp"
+#include "output_sink.hpp"
+#include "budget.hpp"
+
+enum OpCode : uint8_t
+{
+    OP_CONSTANT, OP_NIL, OP_TRUE, OP_FALSE, OP_POP,
+    OP_DEFINE_GLOBAL, OP_GET_GLOBAL, OP_SET_GLOBAL,
+    OP_DEFINE_LOCAL, OP_GET_LOCAL, OP_SET_LOCAL,
+    OP_EQUAL, OP_NOT_EQUAL,
+    OP_GREATER, OP_GREATER_EQUAL, OP_LESS, OP_LESS_EQUAL,
+    OP_ADD, OP_SUB, OP_MUL, OP_DIV,
+    OP_NOT, OP_NEGATE,
+    OP_PRINT,
+    OP_JUMP, OP_JUMP_IF_FALSE, OP_JUMP_IF_TRUE, OP_LOOP,
+    OP_CALL, OP_RETURN, OP_HALT
+};
+
+struct Chunk
+{
+    std::vector<uint8_t> code;
+    std::vector<int> lines;
+    std::vector<Value> constants;
+    int maxStack = 0;
+    uint32_t frameSize = 0;
+    void write(uint8_t byte, int line)
+    {
+        code.push_back(byte);
+        lines.push_back(line);
+    }
+    void writeOperand(uint32_t operand, int line)
+    {
+        for(int i = 0; i < 4; i++)
+        write((operand >> (8 * i)) & 0xff, line);
+    }
+    void patch(size_t at, uint32_t operand)
+    {
+        for(int i = 0; i < 4; i++)
+        code[at + i] = (operand >> (8 * i)) & 0xff;
+    }
+};
+
+struct compiler : public ExprVisitor, public StmtVisitor
+{
+    Chunk& chunk;
+    int line = 1;
+    int depth = 0;
+    int* high;
+    const Function* function = nullptr;
+    compiler(Chunk& chunk):
+    chunk(chunk), high(&chunk.maxStack){}
+    void compile(const std::vector<Stmt*>& statements)
+    {
+        for(size_t i = 0; i < statements.size(); i++)
+        {
+            statements[i]->accept(*this);
+        }
+        emit(OP_HALT, 0);
+    }
+    size_t compile(Stmt* statement)
+    {
+        size_t start = chunk.code.size();
+        statement->accept(*this);
+        emit(OP_HALT, 0);
+        return start;
+    }
+    void emit(OpCode op, int effect)
+    {
+        chunk.write(op, line);
+        depth += effect;
+        if(depth > *high)
+        *high = depth;
+    }
+    void emit(OpCode op, uint32_t operand, int effect)
+    {
+        emit(op, effect);
+        chunk.writeOperand(operand, line);
+    }
+    size_t emitJump(OpCode op)
+    {
+        emit(op, 0xffffffff, 0);
+        return chunk.code.size() - 4;
+    }
+    void patch(size_t at)
+    {
+        chunk.patch(at, chunk.code.size());
+    }
+    uint32_t constant(Value value)
+    {
+        chunk.constants.push_back(std::move(value));
+        return chunk.constants.size() - 1;
+    }
+    void compile(Expr* expr)
+    {
+        expr->accept(*this);
+    }
+    Value visitBinaryExpr(const Binary& expr)
+    {
+        compile(expr.left);
+        compile(expr.right);
+        line = expr.op->line;
+        switch(expr.op->type)
+        {
+            case TokenType::ADD: emit(OP_ADD, -1); break;
+            case TokenType::SUB: emit(OP_SUB, -1); break;
+            case TokenType::MUL: emit(OP_MUL, -1); break;
+            case TokenType::DIV: emit(OP_DIV, -1); break;
+            case TokenType::GREATER: emit(OP_GREATER, -1); break;
+            case TokenType::GREATER_EQUAL: emit(OP_GREATER_EQUAL, -1); break;
+            case TokenType::LESS: emit(OP_LESS, -1); break;
+            case TokenType::LESS_EQUAL: emit(OP_LESS_EQUAL, -1); break;
+            case TokenType::NOT_EQUAL: emit(OP_NOT_EQUAL, -1); break;
+            case TokenType::EQUAL_EQUAL: emit(OP_EQUAL, -1); break;
+            default:
+            throw RuntimeError(expr.op, "Unexpected binary operator.");
+        }
+        return Value();
+    }
+    Value visitUnaryExpr(const Unary& expr)
+    {
+        compile(expr.right);
+        line = expr.op->line;
+        switch(expr.op->type)
+        {
+            case TokenType::SUB: emit(OP_NEGATE, 0); break;
+            case TokenType::NOT: emit(OP_NOT, 0); break;
+            default:
+            throw RuntimeError(expr.op, "Unexpected unary operator.");
+        }
+        return Value();
+    }
+    Value visitLiteralExpr(const Literal& expr)
+    {
+        switch(expr.value.type)
+        {
+            case ValueType::NIL: emit(OP_NIL, 1); break;
+            case ValueType::BOOL: emit(expr.value.asBool() ? OP_TRUE : OP_FALSE, 1); break;
+            default: emit(OP_CONSTANT, constant(expr.value), 1); break;
+        }
+        return Value();
+    }
+    Value visitGroupingExpr(const Grouping& expr)
+    {
+        compile(expr.expression);
+        return Value();
+    }
+    Value visitVariableExpr(const Variable& expr)
+    {
+        line = expr.token->line;
+        emit(expr.binding.depth == Binding::LOCAL ? OP_GET_LOCAL : OP_GET_GLOBAL, expr.binding.slot, 1);
+        return Value();
+    }
+    Value visitAssignExpr(const Assign& expr)
+    {
+        compile(expr.expression);
+        line = expr.token->line;
+        emit(expr.binding.depth == Binding::LOCAL ? OP_SET_LOCAL : OP_SET_GLOBAL, expr.binding.slot, 0);
+        return Value();
+    }
+    Value visitLogicalExpr(const Logical& expr)
+    {
+        compile(expr.left);
+        line = expr.op->line;
+        size_t end = emitJump(expr.op->type == TokenType::OR ? OP_JUMP_IF_TRUE : OP_JUMP_IF_FALSE);
+        emit(OP_POP, -1);
+        compile(expr.right);
+        patch(end);
+        return Value();
+    }
+    Value visitCallExpr(const Call& expr)
+    {
+        compile(expr.callee);
+        for(uint32_t i = 0; i < expr.count; i++)
+        compile(expr.arguments[i]);
+        line = expr.paren->line;
+        emit(OP_CALL, expr.count, -(int)expr.count);
+        return Value();
+    }
+    void visitExpressionStmt(const Expression& stmt)
+    {
+        compile(stmt.expression);
+        emit(OP_POP, -1);
+    }
+    void visitPrintStmt(const Print& stmt)
+    {
+        compile(stmt.printExpression);
+        emit(OP_PRINT, -1);
+    }
+    void visitVarStmt(const Var& stmt)
+    {
+        if(stmt.expression != nullptr)
+        compile(stmt.expression);
+        else
+        emit(OP_NIL, 1);
+        line = stmt.token->line;
+        if(stmt.binding.depth == Binding::GLOBAL)
+        {
+            emit(OP_DEFINE_GLOBAL, stmt.binding.slot, -1);
+            return;
+        }
+        emit(OP_DEFINE_LOCAL, stmt.binding.slot, -1);
+        if(function == nullptr && stmt.binding.slot >= chunk.frameSize)
+        chunk.frameSize = stmt.binding.slot + 1;
+    }
+    void visitBlockStmt(const Block& stmt)
+    {
+        for(uint32_t i = 0; i < stmt.count; i++)
+        stmt.statements[i]->accept(*this);
+    }
+    void visitIfStmt(const If& stmt)
+    {
+        compile(stmt.condition);
+        size_t otherwise = emitJump(OP_JUMP_IF_FALSE);
+        emit(OP_POP, -1);
+        stmt.thenBranch->accept(*this);
+        size_t end = emitJump(OP_JUMP);
+        patch(otherwise);
+        depth++;
+        emit(OP_POP, -1);
+        if(stmt.elseBranch != nullptr)
+        stmt.elseBranch->accept(*this);
+        patch(end);
+    }
+    void visitWhileStmt(const While& stmt)
+    {
+        uint32_t start = chunk.code.size();
+        compile(stmt.condition);
+        size_t exit = emitJump(OP_JUMP_IF_FALSE);
+        emit(OP_POP, -1);
+        stmt.body->accept(*this);
+        line = stmt.line;
+        emit(OP_LOOP, start, 0);
+        patch(exit);
+        depth++;
+        emit(OP_POP, -1);
+    }
+    void visitFunctionStmt(const Function& stmt)
+    {
+        line = stmt.name->line;
+        size_t over = emitJump(OP_JUMP);
+        stmt.chunk = &chunk;
+        stmt.entry = chunk.code.size();
+        int outerDepth = depth;
+        int* outerHigh = high;
+        int functionHigh = 0;
+        depth = 0;
+        high = &functionHigh;
+        function = &stmt;
+        for(uint32_t i = 0; i < stmt.count; i++)
+        stmt.body[i]->accept(*this);
+        emit(OP_NIL, 1);
+        emit(OP_RETURN, -1);
+        function = nullptr;
+        stmt.maxStack = functionHigh;
+        depth = outerDepth;
+        high = outerHigh;
+        patch(over);
+        line = stmt.name->line;
+        emit(OP_CONSTANT, constant(Value(&stmt)), 1);
+        emit(OP_DEFINE_GLOBAL, stmt.binding.slot, -1);
+    }
+    void visitReturnStmt(const Return& stmt)
+    {
+        if(stmt.value != nullptr)
+        compile(stmt.value);
+        else
+        emit(OP_NIL, 1);
+        line = stmt.keyword->line;
+        emit(OP_RETURN, -1);
+    }
+    void visitIncrementStmt(const Increment& stmt)
+    {
+        stmt.original->accept(*this);
+    }
+    void visitStoreStmt(const Store& stmt)
+    {
+        stmt.original->accept(*this);
+    }
+    void visitPrintBinaryStmt(const PrintBinary& stmt)
+    {
+        stmt.original->accept(*this);
+    }
+};
+
+struct vm
+{
+    static constexpr int MAX_CALL_DEPTH = 1000;
+    struct CallFrame
+    {
+        const Chunk* chunk;
+        const uint8_t* ip;
+        size_t base;
+    };
+    Environment& globals;
+    std::vector<Value> stack;
+    std::vector<CallFrame> frames;
+    OutputSink* out;
+    budget meter;
+    vm(Environment& globals, OutputSink& out):
+    globals(globals), out(&out){}
+    bool interpret(const Chunk& chunk, Diagnostics& diagnostics, size_t offset = 0)
+    {
+        try
+        {
+            run(chunk, offset);
+            return true;
+        }
+        catch(const RuntimeError& error)
+        {
+            frames.clear();
+            diagnostics.push_back(Diagnostic{Diagnostic::RUNTIME, error.line, error.what()});
+            return false;
+        }
+    }
+    RuntimeError error(const Chunk& chunk, const uint8_t* ip, const std::string& message)
+    {
+        int line = chunk.lines[ip - 1 - chunk.code.data()];
+        return RuntimeError(line, message);
+    }
+    void checkpoint(const Chunk& chunk, const uint8_t* ip)
+    {
+        if(const char* message = meter.charge())
+        throw error(chunk, ip, message);
+    }
+    void run(const Chunk& script, size_t offset)
+    {
+        if(stack.size() < script.frameSize + script.maxStack + 1)
+        stack.resize(script.frameSize + script.maxStack + 1);
+        if(frames.capacity() < MAX_CALL_DEPTH)
+        frames.reserve(MAX_CALL_DEPTH);
+        const Chunk* chunk = &script;
+        const uint8_t* ip = chunk->code.data() + offset;
+        const Value* constants = chunk->constants.data();
+        Value* slots = globals.slots.data();
+        Value* base = stack.data();
+        Value* top = base + chunk->frameSize;
+        uint32_t operand;
+        #define READ_OPERAND() (std::memcpy(&operand, ip, 4), ip += 4, operand)
+        #define NUMBER_OPERANDS() \
+            if(!top[-2].isNumber() || !top[-1].isNumber()) \
+            throw error(*chunk, ip, "Operands must be numbers.");
+        #define BINARY_OP(op) \
+            NUMBER_OPERANDS(); \
+            top[-2] = top[-2].asNumber() op top[-1].asNumber(); \
+            top--;
+        #if defined(__GNUC__)
+        static void* labels[] =
+        {
+            &&L_OP_CONSTANT, &&L_OP_NIL, &&L_OP_TRUE, &&L_OP_FALSE, &&L_OP_POP,
+            &&L_OP_DEFINE_GLOBAL, &&L_OP_GET_GLOBAL, &&L_OP_SET_GLOBAL,
+            &&L_OP_DEFINE_LOCAL, &&L_OP_GET_LOCAL, &&L_OP_SET_LOCAL,
+            &&L_OP_EQUAL, &&L_OP_NOT_EQUAL,
+            &&L_OP_GREATER, &&L_OP_GREATER_EQUAL, &&L_OP_LESS, &&L_OP_LESS_EQUAL,
+            &&L_OP_ADD, &&L_OP_SUB, &&L_OP_MUL, &&L_OP_DIV,
+            &&L_OP_NOT, &&L_OP_NEGATE,
+            &&L_OP_PRINT,
+            &&L_OP_JUMP, &&L_OP_JUMP_IF_FALSE, &&L_OP_JUMP_IF_TRUE, &&L_OP_LOOP,
+            &&L_OP_CALL, &&L_OP_RETURN, &&L_OP_HALT
+        };
+        #define DISPATCH() goto *labels[*ip++]
+        #define CASE(op) L_##op
+        #else
+        #define DISPATCH() break
+        #define CASE(op) case op
+        #endif
+        try
+        {
+        #if defined(__GNUC__)
+        DISPATCH();
+        #else
+        for(;;)
+        switch(*ip++)
+        {
+        #endif
+            CASE(OP_CONSTANT):
+            *top++ = constants[READ_OPERAND()];
+            DISPATCH();
+            CASE(OP_NIL):
+            *top++ = Value();
+            DISPATCH();
+            CASE(OP_TRUE):
+            *top++ = Value(true);
+            DISPATCH();
+            CASE(OP_FALSE):
+            *top++ = Value(false);
+            DISPATCH();
+            CASE(OP_POP):
+            (--top)->release();
+            top->type = ValueType::NIL;
+            DISPATCH();
+            CASE(OP_DEFINE_GLOBAL):
+            slots[READ_OPERAND()] = std::move(*--top);
+            DISPATCH();
+            CASE(OP_GET_GLOBAL):
+            *top++ = slots[READ_OPERAND()];
+            DISPATCH();
+            CASE(OP_SET_GLOBAL):
+            slots[READ_OPERAND()] = top[-1];
+            DISPATCH();
+            CASE(OP_DEFINE_LOCAL):
+            base[READ_OPERAND()] = std::move(*--top);
+            DISPATCH();
+            CASE(OP_GET_LOCAL):
+            *top++ = base[READ_OPERAND()];
+            DISPATCH();
+            CASE(OP_SET_LOCAL):
+            base[READ_OPERAND()] = top[-1];
+            DISPATCH();
+            CASE(OP_EQUAL):
+            top[-2] = isEqual(top[-2], top[-1]);
+            (--top)->release();
+            top->type = ValueType::NIL;
+            DISPATCH();
+            CASE(OP_NOT_EQUAL):
+            top[-2] = !isEqual(top[-2], top[-1]);
+            (--top)->release();
+            top->type = ValueType::NIL;
+            DISPATCH();
+            CASE(OP_GREATER):
+            BINARY_OP(>);
+            DISPATCH();
+            CASE(OP_GREATER_EQUAL):
+            BINARY_OP(>=);
+            DISPATCH();
+            CASE(OP_LESS):
+            BINARY_OP(<);
+            DISPATCH();
+            CASE(OP_LESS_EQUAL):
+            BINARY_OP(<=);
+            DISPATCH();
+            CASE(OP_ADD):
+            if(top[-2].isNumber() && top[-1].isNumber())
+            {
+                top[-2].as.number += top[-1].as.number;
+                top--;
+            }
+            else if(top[-2].isString() && top[-1].isString())
+            {
+                top[-2] = concatenate(top[-2], top[-1]);
+                (--top)->release();
+                top->type = ValueType::NIL;
+            }
+            else
+            throw error(*chunk, ip, "Operands must be either strings or numbers.");
+            DISPATCH();
+            CASE(OP_SUB):
+            BINARY_OP(-);
+            DISPATCH();
+            CASE(OP_MUL):
+            BINARY_OP(*);
+            DISPATCH();
+            CASE(OP_DIV):
+            BINARY_OP(/);
+            DISPATCH();
+            CASE(OP_NOT):
+            top[-1] = !isTrue(top[-1]);
+            DISPATCH();
+            CASE(OP_NEGATE):
+            if(!top[-1].isNumber())
+            throw error(*chunk, ip, "Operand must be a number.");
+            top[-1].as.number = -top[-1].as.number;
+            DISPATCH();
+            CASE(OP_PRINT):
+            out->print(*--top);
+            top->release();
+            top->type = ValueType::NIL;
+            DISPATCH();
+            CASE(OP_JUMP):
+            ip = chunk->code.data() + READ_OPERAND();
+            DISPATCH();
+            CASE(OP_JUMP_IF_FALSE):
+            READ_OPERAND();
+            if(!isTrue(top[-1]))
+            ip = chunk->code.data() + operand;
+            DISPATCH();
+            CASE(OP_JUMP_IF_TRUE):
+            READ_OPERAND();
+            if(isTrue(top[-1]))
+            ip = chunk->code.data() + operand;
+            DISPATCH();
+            CASE(OP_LOOP):
+            READ_OPERAND();
+            if(meter.tick() == true)
+            checkpoint(*chunk, ip);
+            ip = chunk->code.data() + operand;
+            DISPATCH();
+            CASE(OP_CALL):
+            {
+                uint32_t count = READ_OPERAND();
+                Value* callee = top - count - 1;
+                if(!callee->isFunction())
+                throw error(*chunk, ip, "Can only call functions.");
+                const Function* function = callee->asFunction();
+                if(count != function->arity)
+                throw error(*chunk, ip, "Expected " + std::to_string(function->arity) + " arguments but got " + std::to_string(count) + ".");
+                if(frames.size() >= MAX_CALL_DEPTH)
+                throw error(*chunk, ip, "Stack overflow.");
+                if(meter.tick() == true)
+                checkpoint(*chunk, ip);
+                size_t needed = (callee + 1 - stack.data()) + function->slots + function->maxStack + 1;
+                if(needed > stack.size())
+                {
+                    size_t calleeIndex = callee - stack.data();
+                    size_t baseIndex = base - stack.data();
+                    stack.resize(needed * 2);
+                    callee = stack.data() + calleeIndex;
+                    base = stack.data() + baseIndex;
+                }
+                frames.push_back(CallFrame{chunk, ip, (size_t)(base - stack.data())});
+                base = callee + 1;
+                top = base + function->slots;
+                chunk = function->chunk;
+                constants = chunk->constants.data();
+                ip = chunk->code.data() + function->entry;
+                DISPATCH();
+            }
+            CASE(OP_RETURN):
+            {
+                Value result = std::move(*--top);
+                Value* callee = base - 1;
+                while(top > callee)
+                {
+                    (--top)->release();
+                    top->type = ValueType::NIL;
+                }
+                *top++ = std::move(result);
+                const CallFrame& frame = frames.back();
+                chunk = frame.chunk;
+                constants = chunk->constants.data();
+                ip = frame.ip;
+                base = stack.data() + frame.base;
+                frames.pop_back();
+                DISPATCH();
+            }
+            CASE(OP_HALT):
+            return;
+        #if !defined(__GNUC__)
+        }
+        #endif
+        }
+        catch(const LimitError& limit)
+        {
+            throw error(*chunk, ip, limit.what());
+        }
+        #undef READ_OPERAND
+        #undef NUMBER_OPERANDS
+        #undef BINARY_OP
+        #undef DISPATCH
+        #undef CASE
+    }
+};
+#endif